@@ -0,0 +1,132 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+//-------------------------------------
+namespace MindShake {
+
+    //-------------------------------------
+    // Lock-free multi-producer multi-consumer queue with a fixed capacity (Dmitry Vyukov's bounded queue).
+    // Every cell has a sequence number that tells the producers and the consumers whose turn it is,
+    // so both sides only need a CAS on their own position.
+    template <typename T>
+    class BoundedQueue {
+        public:
+            // The capacity is rounded up to a power of two
+            explicit        BoundedQueue(size_t capacity);
+
+                            BoundedQueue(const BoundedQueue &)  = delete;
+            BoundedQueue &  operator=(const BoundedQueue &)     = delete;
+
+            // Returns false if the queue is full ('value' is not moved then)
+            bool            TryPush(T &&value);
+            // Returns false if the queue is empty
+            bool            TryPop(T &value);
+
+            size_t          GetCapacity() const     { return mMask + 1; }
+
+        protected:
+            static constexpr size_t kCacheLine = 64;
+
+            struct Cell {
+                std::atomic<size_t> sequence;
+                T                   value;
+            };
+
+        protected:
+            std::unique_ptr<Cell[]> mCells;
+            size_t                  mMask;
+            char                    padding0[kCacheLine];
+            std::atomic<size_t>     mPushPos { 0 };
+            char                    padding1[kCacheLine];
+            std::atomic<size_t>     mPopPos { 0 };
+            char                    padding2[kCacheLine];
+    };
+
+    //-------------------------------------
+    template <typename T>
+    inline
+    BoundedQueue<T>::BoundedQueue(size_t capacity) {
+        size_t size = 2;
+
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        mCells.reset(new Cell[size]);
+        mMask = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    //-------------------------------------
+    template <typename T>
+    inline bool
+    BoundedQueue<T>::TryPush(T &&value) {
+        size_t pos = mPushPos.load(std::memory_order_relaxed);
+        Cell   *cell;
+
+        while (true) {
+            cell = &mCells[pos & mMask];
+            size_t    sequence = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff     = ptrdiff_t(sequence) - ptrdiff_t(pos);
+            if (diff == 0) {
+                if (mPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = mPushPos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    //-------------------------------------
+    template <typename T>
+    inline bool
+    BoundedQueue<T>::TryPop(T &value) {
+        size_t pos = mPopPos.load(std::memory_order_relaxed);
+        Cell   *cell;
+
+        while (true) {
+            cell = &mCells[pos & mMask];
+            size_t    sequence = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff     = ptrdiff_t(sequence) - ptrdiff_t(pos + 1);
+            if (diff == 0) {
+                if (mPopPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = mPopPos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+} // end of namespace
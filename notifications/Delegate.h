@@ -9,15 +9,21 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 #include <vector>
+#include <memory>
 #include <type_traits>
 #include <algorithm>
+#include "WorkerPool.h"
 
 //-------------------------------------
 namespace MindShake {
 
     #define kUnConst(method)        reinterpret_cast<void(Class::*)(Args...)>(method)
     #define kMethod(method)         void(Class::*method)(Args...)
+    #define kUnConstBool(method)    reinterpret_cast<bool(Class::*)(Args...)>(method)
+    #define kMethodBool(method)     bool(Class::*method)(Args...)
+    #define kBoolToVoid(method)     signature_cast<void(Class::*)(Args...)>(method)
     #define kOnlyClassSizeT         typename std::enable_if<std::is_class<Class>::value, size_t>::type
     #define kOnlyClassPtrD          typename std::enable_if<std::is_class<Class>::value, ptrdiff_t>::type
 
@@ -43,6 +49,78 @@ namespace MindShake {
         return method;
     }
 
+    //-------------------------------------
+    // Move-only handle returned by Delegate::Connect. Destroying it removes the callable (and its captures)
+    // right away, or when the current call of the delegate ends.
+    // It can outlive the delegate, but as with Remove, use it on the thread that owns the delegate.
+    class Connection {
+        public:
+            struct Link {
+                void    *delegate;
+                void    *wrapper;   // nullptr once the callable is removed (by any means)
+                void    (*disconnect)(void *delegate, void *wrapper);
+            };
+
+        public:
+                            Connection() = default;
+            explicit        Connection(std::shared_ptr<Link> link) : mLink(std::move(link)) {}
+                            ~Connection()                                   { Disconnect();                                     }
+
+                            Connection(Connection &&other) noexcept : mLink(std::move(other.mLink)) {}
+            Connection &    operator=(Connection &&other) noexcept          { if (this != &other) { Disconnect(); mLink = std::move(other.mLink); } return *this; }
+
+                            Connection(const Connection &)                  = delete;
+            Connection &    operator=(const Connection &)                   = delete;
+
+            void            Disconnect() {
+                if (mLink != nullptr) {
+                    if (mLink->wrapper != nullptr)
+                        mLink->disconnect(mLink->delegate, mLink->wrapper);
+                    mLink = nullptr;
+                }
+            }
+
+            // Forgets the callable without removing it
+            void            Release()                                       { mLink = nullptr;                                  }
+
+            bool            IsConnected() const                             { return mLink != nullptr && mLink->wrapper != nullptr; }
+
+        protected:
+            std::shared_ptr<Link>   mLink;
+    };
+
+    //-------------------------------------
+    // Disconnects all its connections when destroyed
+    class ScopedConnections {
+        public:
+                                ScopedConnections() = default;
+                                ~ScopedConnections()                            { DisconnectAll();                                  }
+
+                                ScopedConnections(ScopedConnections &&)         = default;
+            ScopedConnections & operator=(ScopedConnections &&other) noexcept   { if (this != &other) { DisconnectAll(); mConnections = std::move(other.mConnections); } return *this; }
+
+                                ScopedConnections(const ScopedConnections &)    = delete;
+            ScopedConnections & operator=(const ScopedConnections &)            = delete;
+
+            ScopedConnections & operator+=(Connection &&connection)             { Add(std::move(connection)); return *this;         }
+
+            void                Add(Connection &&connection) {
+                // Forget the ones already disconnected instead of growing
+                if (mConnections.size() == mConnections.capacity()) {
+                    mConnections.erase(std::remove_if(mConnections.begin(), mConnections.end(),
+                                                      [](const Connection &c) { return c.IsConnected() == false; }), mConnections.end());
+                }
+                mConnections.emplace_back(std::move(connection));
+            }
+
+            void                DisconnectAll()                                 { mConnections.clear();                             }
+
+            size_t              GetSize() const                                 { return mConnections.size();                       }
+
+        protected:
+            std::vector<Connection> mConnections;
+    };
+
     //-------------------------------------
     template <typename T>
     class Delegate;
@@ -54,7 +132,9 @@ namespace MindShake {
             class UnknownClass;
 
             using TFunc         = void (              *)(Args...);
+            using TFuncBool     = bool (              *)(Args...);
             using TMethod       = void (UnknownClass::*)(Args...);  // Longest method signature
+            using TMethodBool   = bool (UnknownClass::*)(Args...);
 
         protected:
             static size_t wrapperCounter;
@@ -63,14 +143,17 @@ namespace MindShake {
             struct Wrapper {
                                 Wrapper() = default;
                 explicit        Wrapper(TFunc f) : func(f) {}
-                virtual         ~Wrapper() { object = nullptr; func = nullptr;     }
+                virtual         ~Wrapper() { object = nullptr; func = nullptr; Unlink(); }
 
-                virtual void    operator()(const Args&... args) const {
+                // Returns true if the call was consumed
+                virtual bool    operator()(const Args&... args) const {
                     if (object != nullptr)       ((object)->*(method))(args...);
                     else if (func != nullptr)    (*func)(args...);
+                    return false;
                 }
 
-                void            ToBeRemoved() { object = nullptr, method = {}, isEnabled = false; }
+                void            ToBeRemoved() { object = nullptr, method = {}, isEnabled = false; Unlink(); }
+                void            Unlink()      { if (link != nullptr) { link->wrapper = nullptr; link = nullptr; } }
 
                 enum class Type { Unknown, Function, Method, Lambda };
 
@@ -82,16 +165,30 @@ namespace MindShake {
                 };
                 size_t  id        = wrapperCounter++;
                 Type    type      = Type::Unknown;
-                bool    isEnabled = true;
+                int     priority  = 0;
+                bool    isEnabled = true;       // false: removed lazily (or disconnected) but not deleted yet
+                std::shared_ptr<Connection::Link> link;
             };
 
             //-----------------------------
             struct WrapperCFunc : Wrapper {
                 explicit    WrapperCFunc(TFunc f) : Wrapper(f) { Wrapper::type = Wrapper::Type::Function; }
 
-                void        operator()(const Args&... args) const override {
+                bool        operator()(const Args&... args) const override {
                     if(Wrapper::func != nullptr)
                         (*Wrapper::func)(args...);
+                    return false;
+                }
+            };
+
+            //-----------------------------
+            struct WrapperCFuncBool : Wrapper {
+                explicit    WrapperCFuncBool(TFuncBool f) : Wrapper(signature_cast<TFunc>(f)) { Wrapper::type = Wrapper::Type::Function; }
+
+                bool        operator()(const Args&... args) const override {
+                    if(Wrapper::func != nullptr)
+                        return (*signature_cast<TFuncBool>(Wrapper::func))(args...);
+                    return false;
                 }
             };
 
@@ -99,9 +196,21 @@ namespace MindShake {
             struct WrapperMethod : Wrapper {
                         WrapperMethod() { Wrapper::type = Wrapper::Type::Method; }
 
-                void    operator()(const Args&... args) const override {
+                bool    operator()(const Args&... args) const override {
                     if(Wrapper::object != nullptr)
                         ((Wrapper::object)->*(Wrapper::method))(args...);
+                    return false;
+                }
+            };
+
+            //-----------------------------
+            struct WrapperMethodBool : Wrapper {
+                        WrapperMethodBool() { Wrapper::type = Wrapper::Type::Method; }
+
+                bool    operator()(const Args&... args) const override {
+                    if(Wrapper::object != nullptr)
+                        return ((Wrapper::object)->*(signature_cast<TMethodBool>(Wrapper::method)))(args...);
+                    return false;
                 }
             };
 
@@ -111,11 +220,18 @@ namespace MindShake {
             struct WrapperLambda : Wrapper {
                 explicit WrapperLambda(const Lambda &l) : lambda(l) { Wrapper::type = Wrapper::Type::Lambda; }
 
-                void    operator()(const Args&... args) const override {
+                bool    operator()(const Args&... args) const override {
                     if(Wrapper::isEnabled)
-                        lambda(args...);
+                        return Call(std::is_same<Result, bool>(), args...);
+                    return false;
                 }
 
+                // Only a bool result consumes the call, any other result is ignored
+                bool    Call(std::false_type, const Args&... args) const    { lambda(args...); return false;    }
+                bool    Call(std::true_type, const Args&... args) const     { return lambda(args...);           }
+
+                using   Result = decltype(std::declval<const Lambda &>()(std::declval<const Args &>()...));
+
                 Lambda  lambda;
             };
 
@@ -124,6 +240,10 @@ namespace MindShake {
             template <class Class>
             static Class *  unconst(const Class *object)                                        { return const_cast<Class *>(object);                           }
 
+            // Same bits with other signature (a reinterpret_cast triggers -Wcast-function-type)
+            template <typename To, typename From>
+            static To       signature_cast(From from)                                           { To to {}; memcpy(&to, &from, sizeof(From)); return to;        }
+
         public:
                             Delegate() = default;
             virtual         ~Delegate();
@@ -132,6 +252,8 @@ namespace MindShake {
             size_t          Add(std::nullptr_t)                                                 { return size_t(-1);                                            }
 
             size_t          Add(TFunc func);
+            // Callables returning bool consume the call when they return true (the rest are not called)
+            size_t          Add(TFuncBool func);
 
             template <class Class>
             kOnlyClassSizeT Add(Class *object)                                                  { return Add(object, getNonConstMethod(&Class::operator()));    }
@@ -154,19 +276,35 @@ namespace MindShake {
             kOnlyClassSizeT Add(kMethod(method) const, Class *object)                           { return Add(object, kUnConst(method));                         }
             template <class Class>
             kOnlyClassSizeT Add(kMethod(method) const, const Class *object)                     { return Add(unconst(object), kUnConst(method));                }
+            template <class Class>
+            kOnlyClassSizeT Add(Class *object, kMethodBool(method));
+            template <class Class>
+            kOnlyClassSizeT Add(const Class *object, kMethodBool(method))                       { return Add(unconst(object), method);                          }
+            template <class Class>
+            kOnlyClassSizeT Add(Class *object, kMethodBool(method) const)                       { return Add(object, kUnConstBool(method));                     }
+            template <class Class>
+            kOnlyClassSizeT Add(const Class *object, kMethodBool(method) const)                 { return Add(unconst(object), kUnConstBool(method));            }
 
             // Hack to detect lambdas with captures
             template <typename Lambda, typename std::enable_if<!std::is_assignable<Lambda, Lambda>::value, bool>::type = true>
-            size_t          Add(const Lambda &lambda) {
-                auto wrapper = new WrapperLambda<Lambda>(lambda);
-                mWrappers.emplace_back(wrapper);
-                return wrapper->id;
-            }
+            size_t          Add(const Lambda &lambda)                                           { return AddWrapper(new WrapperLambda<Lambda>(lambda));         }
+
+            // Callables with higher priority are called first. Same priority: in order of insertion.
+            template <typename ...Callable>
+            size_t          AddWithPriority(int priority, Callable &&...callable)               { return SetPriority(Add(std::forward<Callable>(callable)...), priority); }
+            size_t          SetPriority(size_t id, int priority);
+
+            // Same as Add, but the callable is removed when the returned handle is destroyed
+            template <typename ...Callable>
+            Connection      Connect(Callable &&...callable)                                     { return MakeConnection(Add(std::forward<Callable>(callable)...)); }
+            template <typename ...Callable>
+            Connection      ConnectWithPriority(int priority, Callable &&...callable)           { return MakeConnection(AddWithPriority(priority, std::forward<Callable>(callable)...)); }
 
             //--
             bool            Remove(std::nullptr_t, bool lazy=false)                             { return false;                                                 }
 
             bool            Remove(TFunc func, bool lazy=false)                                 { return RemoveIndex(Find(func), lazy);                         }
+            bool            Remove(TFuncBool func, bool lazy=false)                             { return RemoveIndex(Find(signature_cast<TFunc>(func)), lazy);    }
 
             template <class Class>
             bool            Remove(Class *object, bool lazy=false)                              { return RemoveIndex(Find(object, getNonConstMethod(&Class::operator())), lazy);        }
@@ -189,6 +327,15 @@ namespace MindShake {
             bool            Remove(kMethod(method) const, Class *object, bool lazy=false)       { return RemoveIndex(Find(object, kUnConst(method)), lazy);     }
             template <class Class>
             bool            Remove(kMethod(method) const, const Class *object, bool lazy=false) { return RemoveIndex(Find(unconst(object), kUnConst(method)), lazy);    }
+            // Methods returning bool are stored and found as the void ones
+            template <class Class>
+            bool            Remove(Class *object, kMethodBool(method), bool lazy=false)         { return RemoveIndex(Find(object, kBoolToVoid(method)), lazy);     }
+            template <class Class>
+            bool            Remove(const Class *object, kMethodBool(method), bool lazy=false)   { return RemoveIndex(Find(unconst(object), kBoolToVoid(method)), lazy);    }
+            template <class Class>
+            bool            Remove(Class *object, kMethodBool(method) const, bool lazy=false)   { return RemoveIndex(Find(object, kBoolToVoid(method)), lazy);     }
+            template <class Class>
+            bool            Remove(const Class *object, kMethodBool(method) const, bool lazy=false) { return RemoveIndex(Find(unconst(object), kBoolToVoid(method)), lazy);    }
             // Hack to detect lambdas with captures (and return a value)
             //template <typename Lambda, std::enable_if_t<!std::is_assignable_v<Lambda, Lambda>, bool> = true>
             //bool            Remove(const Lambda &l) {
@@ -208,13 +355,41 @@ namespace MindShake {
             // So, we need the other version of operator() to pass const references.
             // In any case, the Wrappers cannot have both operators() because they are virtual functions,
             // and a template function cannot be virtual.
-            template <typename Dummy = void>
+            // Both return true if some callable consumed the call.
+            // Callables can be added or removed while calling (see DispatchScope).
+            template <typename Dummy = bool>
             typename std::enable_if<sizeof...(Args) != 0, Dummy>::type
-                            operator()(Args&&... args) const                                    { for (const auto *wrapper : mWrappers) (*wrapper)(std::forward<Args>(args)...); }
+                            operator()(Args&&... args) const {
+                if (mParallelMin != 0 && mWrappers.size() >= mParallelMin)
+                    return (*this)(static_cast<const Args &>(args)...);
+                const DispatchScope scope(*this);
+                for (size_t i = 0, size = mWrappers.size(); i < size; ++i) {
+                    if ((*mWrappers[i])(std::forward<Args>(args)...))
+                        return true;
+                }
+                return false;
+            }
+
+            bool            operator()(const Args&... args) const {
+                const DispatchScope scope(*this);
+                if (mParallelMin != 0 && mWrappers.size() >= mParallelMin)
+                    return CallParallel(args...);
+                for (size_t i = 0, size = mWrappers.size(); i < size; ++i) {
+                    if ((*mWrappers[i])(args...))
+                        return true;
+                }
+                return false;
+            }
+
+            bool            IsDispatching() const                                               { return mDispatchDepth != 0;                               }
 
-            void            operator()(const Args&... args) const                               { for (const auto *wrapper : mWrappers) (*wrapper)(args...);    }
+            // For independent, thread-safe callables: when there are at least 'minCallables' of them, they are
+            // split across WorkerPool::GetDefault() and called in parallel (the call returns when all are done).
+            // Priorities and consuming are ignored in that case, and the callables must not modify this delegate.
+            void            SetParallel(bool set, size_t minCallables = 64)                     { mParallelMin = set ? (minCallables > 0 ? minCallables : 1) : 0; }
+            bool            IsParallel() const                                                  { return mParallelMin != 0;                                 }
 
-            size_t          GetNumDelegates() const                                             { return mWrappers.size() - mToRemove.size();               }
+            size_t          GetNumDelegates() const                                             { return mWrappers.size() - mNumDead;                       }
 
         protected:
             ptrdiff_t       Find(std::nullptr_t)                                                { return -1;                                                }
@@ -249,11 +424,38 @@ namespace MindShake {
             //}
 
         protected:
+            // While calling, mWrappers is only appended to (by index, so reallocations are harmless) and removed
+            // wrappers are only disabled. Sorting and deletions are applied when the outermost call returns.
+            struct DispatchScope {
+                explicit    DispatchScope(const Delegate &d) : delegate(d)  { ++delegate.mDispatchDepth;                                     }
+                            ~DispatchScope() {
+                                if (--delegate.mDispatchDepth == 0 && delegate.mHasPending)
+                                    const_cast<Delegate &>(delegate).ApplyPending();
+                            }
+
+                const Delegate  &delegate;
+            };
+
+            void            ApplyPending();
+            bool            CallParallel(const Args&... args) const;
+
+        protected:
+            size_t          AddWrapper(Wrapper *wrapper);
+            size_t          InsertWrapper(Wrapper *wrapper);
             bool            RemoveIndex(ptrdiff_t idx, bool lazy);
+            Connection      MakeConnection(size_t id);
+            static void     Disconnect(void *delegate, void *wrapper);
+
+            // Called every time a callable is added
+            virtual void    OnAdded(const Wrapper &)                                             { }
 
         protected:
             std::vector<Wrapper *> mWrappers;
-            std::vector<size_t>    mToRemove;
+            size_t                 mNumDead {};     // Disabled wrappers still in mWrappers
+            mutable uint32_t       mDispatchDepth {};
+            bool                   mHasPending = false;
+            bool                   mNeedsSort  = false;
+            size_t                 mParallelMin {};    // 0: sequential
     };
 
     //-------------------------------------
@@ -268,7 +470,7 @@ namespace MindShake {
             delete wrapper;
         }
         mWrappers.clear();
-        mToRemove.clear();
+        mNumDead = 0;
     }
 
     //-------------------------------------
@@ -276,9 +478,7 @@ namespace MindShake {
     inline size_t
     Delegate<void(Args...)>::Add(TFunc func) {
         if(func != nullptr) {
-            auto wrapper = new WrapperCFunc(func);
-            mWrappers.emplace_back(wrapper);
-            return wrapper->id;
+            return AddWrapper(new WrapperCFunc(func));
         }
 
         return size_t(-1);
@@ -303,11 +503,103 @@ namespace MindShake {
         wrapper->method = reinterpret_cast<TMethod>(method);
     #endif
 
-        mWrappers.emplace_back(wrapper);
+        return AddWrapper(wrapper);
+    }
+
+    //-------------------------------------
+    template <typename ...Args>
+    inline size_t
+    Delegate<void(Args...)>::Add(TFuncBool func) {
+        if(func != nullptr) {
+            return AddWrapper(new WrapperCFuncBool(func));
+        }
+
+        return size_t(-1);
+    }
+
+    //-------------------------------------
+    template <typename ...Args>
+    template <class Class>
+    inline kOnlyClassSizeT
+    Delegate<void(Args...)>::Add(Class *object, bool(Class::*method)(Args...)) {
+        if(object == nullptr || method == nullptr)
+            return size_t(-1);
+
+        WrapperMethodBool   *wrapper = new WrapperMethodBool;
+
+        wrapper->object = reinterpret_cast<UnknownClass *>(object);
+
+    #if defined(_MSC_VER)
+        memset(reinterpret_cast<void *>(&wrapper->method), 0, sizeof(TMethod));
+        memcpy(reinterpret_cast<void *>(&wrapper->method), reinterpret_cast<void *>(&method), sizeof(method));
+    #else
+        wrapper->method = signature_cast<TMethod>(method);
+    #endif
+
+        return AddWrapper(wrapper);
+    }
+
+    //-------------------------------------
+    template <typename ...Args>
+    inline size_t
+    Delegate<void(Args...)>::AddWrapper(Wrapper *wrapper) {
+        // Disconnected wrappers are removed in batches
+        if(mNumDead * 2 > mWrappers.size() && mDispatchDepth == 0) {
+            RemoveLazyDeleted();
+        }
+        InsertWrapper(wrapper);
+        OnAdded(*wrapper);
 
         return wrapper->id;
     }
 
+    //-------------------------------------
+    // Keeps mWrappers sorted by priority, so calling them never needs to sort
+    template <typename ...Args>
+    inline size_t
+    Delegate<void(Args...)>::InsertWrapper(Wrapper *wrapper) {
+        size_t  index = mWrappers.size();
+
+        // Usually all of them have the same priority
+        if(mWrappers.empty() == false && mWrappers.back()->priority < wrapper->priority) {
+            if(mDispatchDepth != 0) {
+                mWrappers.emplace_back(wrapper);
+                mNeedsSort  = true;
+                mHasPending = true;
+                return index;
+            }
+            auto it = std::upper_bound(mWrappers.begin(), mWrappers.end(), wrapper->priority,
+                                       [](int priority, const Wrapper *other) { return priority > other->priority; });
+            index = size_t(it - mWrappers.begin());
+        }
+        mWrappers.insert(mWrappers.begin() + index, wrapper);
+
+        return index;
+    }
+
+    //-------------------------------------
+    template <typename ...Args>
+    inline size_t
+    Delegate<void(Args...)>::SetPriority(size_t id, int priority) {
+        for(size_t i=0; i<mWrappers.size(); ++i) {
+            if(mWrappers[i]->id == id) {
+                Wrapper *wrapper = mWrappers[i];
+                if(mDispatchDepth != 0) {
+                    wrapper->priority = priority;
+                    mNeedsSort  = true;
+                    mHasPending = true;
+                    return id;
+                }
+                mWrappers.erase(mWrappers.begin() + i);
+                wrapper->priority = priority;
+                InsertWrapper(wrapper);
+                return id;
+            }
+        }
+
+        return size_t(-1);
+    }
+
     //-------------------------------------
     template <typename ...Args>
     inline bool
@@ -326,19 +618,67 @@ namespace MindShake {
     inline bool
     Delegate<void(Args...)>::RemoveIndex(ptrdiff_t idx, bool lazy) {
         if(idx >= 0) {
+            Wrapper *wrapper = mWrappers[idx];
+            if(mDispatchDepth != 0) {
+                lazy        = true;
+                mHasPending = true;
+            }
             if(lazy == false) {
-                delete mWrappers[idx];
+                if(wrapper->isEnabled == false)
+                    --mNumDead;
+                delete wrapper;
                 mWrappers.erase(mWrappers.begin() + idx);
             }
-            else {
-                mWrappers[idx]->ToBeRemoved();
-                mToRemove.emplace_back(idx);
+            else if(wrapper->isEnabled) {
+                wrapper->ToBeRemoved();
+                ++mNumDead;
             }
             return true;
         }
         return false;
     }
 
+    //-------------------------------------
+    template <typename ...Args>
+    inline Connection
+    Delegate<void(Args...)>::MakeConnection(size_t id) {
+        // Usually it is the last one
+        for(auto it = mWrappers.rbegin(); it != mWrappers.rend(); ++it) {
+            if((*it)->id == id) {
+                auto link = std::make_shared<Connection::Link>();
+                link->delegate   = this;
+                link->wrapper    = *it;
+                link->disconnect = &Disconnect;
+                (*it)->link = link;
+                return Connection(std::move(link));
+            }
+        }
+
+        return Connection();
+    }
+
+    //-------------------------------------
+    // While calling, the wrapper (maybe the one running) is only marked and deleted when the call ends
+    template <typename ...Args>
+    inline void
+    Delegate<void(Args...)>::Disconnect(void *delegate, void *wrapper) {
+        Delegate    *self = static_cast<Delegate *>(delegate);
+        Wrapper     *w    = static_cast<Wrapper *>(wrapper);
+
+        if(self->mDispatchDepth == 0) {
+            auto it = std::find(self->mWrappers.begin(), self->mWrappers.end(), w);
+            if(it != self->mWrappers.end()) {
+                self->mWrappers.erase(it);
+                delete w;
+                return;
+            }
+        }
+
+        w->ToBeRemoved();
+        ++self->mNumDead;
+        self->mHasPending = true;
+    }
+
     //-------------------------------------
     template <typename ...Args>
     inline ptrdiff_t
@@ -381,30 +721,82 @@ namespace MindShake {
     template <typename ...Args>
     inline void
     Delegate<void(Args...)>::RemoveLazyDeleted() {
-        ptrdiff_t   i, size;
+        size_t  j = 0;
+
+        if(mNumDead == 0)
+            return;
+
+        if(mDispatchDepth != 0) {
+            mHasPending = true;
+            return;
+        }
 
-        std::sort(mToRemove.begin(), mToRemove.end());
-        size = mToRemove.size() - 1;
-        for(i=size; i>=0; --i) {
-            delete mWrappers[mToRemove[i]];
-            mWrappers.erase(mWrappers.begin() + mToRemove[i]);
+        for(size_t i=0; i<mWrappers.size(); ++i) {
+            if(mWrappers[i]->isEnabled)
+                mWrappers[j++] = mWrappers[i];
+            else
+                delete mWrappers[i];
         }
-        mToRemove.clear();
+        mWrappers.resize(j);
+        mNumDead = 0;
     }
 
     //-------------------------------------
     template <typename ...Args>
     inline void
     Delegate<void(Args...)>::Clear() {
+        if(mDispatchDepth != 0) {
+            for(auto *w : mWrappers) {
+                if(w->isEnabled) {
+                    w->ToBeRemoved();
+                    ++mNumDead;
+                }
+            }
+            mHasPending = true;
+            return;
+        }
+
         for(auto *w : mWrappers) {
             delete w;
         }
         mWrappers.clear();
-        mToRemove.clear();
+        mNumDead = 0;
+    }
+
+    //-------------------------------------
+    template <typename ...Args>
+    inline bool
+    Delegate<void(Args...)>::CallParallel(const Args&... args) const {
+        WorkerPool      &pool    = WorkerPool::GetDefault();
+        const size_t    size     = mWrappers.size();
+        const size_t    numParts = std::min(pool.GetNumWorkers() + 1, size);
+
+        pool.Run(numParts, [&](size_t part) {
+            for (size_t i = size * part / numParts, end = size * (part + 1) / numParts; i < end; ++i) {
+                (*mWrappers[i])(args...);
+            }
+        });
+
+        return false;
+    }
+
+    //-------------------------------------
+    template <typename ...Args>
+    inline void
+    Delegate<void(Args...)>::ApplyPending() {
+        mHasPending = false;
+        if(mNeedsSort) {
+            mNeedsSort = false;
+            std::stable_sort(mWrappers.begin(), mWrappers.end(), [](const Wrapper *a, const Wrapper *b) { return a->priority > b->priority; });
+        }
+        RemoveLazyDeleted();
     }
 
     #undef kUnConst
     #undef kMethod
+    #undef kUnConstBool
+    #undef kMethodBool
+    #undef kBoolToVoid
     #undef kOnlyClassSizeT
     #undef kOnlyClassPtrD
 
@@ -1,4 +1,6 @@
 #include "NotificationManager.h"
+#include <condition_variable>
+#include <algorithm>
 
 //-----------------------------------------------------------------------------
 // Copyright (C) 2021 Carlos Aragonés
@@ -9,29 +11,350 @@
 
 using namespace MindShake;
 
-NotificationManager::TIDMap     NotificationManager::mTIDNotifications;
-NotificationManager::TIDData    NotificationManager::mTIDData;
+//-------------------------------------
+struct NotificationManager::ReplyState {
+    std::mutex                          mutex;
+    std::condition_variable             condition;
+    any                                 value;
+    bool                                isReady = false;
+    TID                                 requester;
+    std::function<void(const any &)>    continuation;
+};
+
+NotificationManager::Threads    NotificationManager::mThreads;
+NotificationManager::Categories NotificationManager::mCategories;
+NotificationManager::Phases     NotificationManager::mPhases;
+NotificationManager::Groups     NotificationManager::mGroups;
+NotificationManager::Merges     NotificationManager::mMerges;
+NotificationManager::TTLs       NotificationManager::mTTLs;
 std::mutex                      NotificationManager::mMutex;
 fake_mutex                      NotificationManager::mFakeMutex;
 bool                            NotificationManager::mEnableMT = true;
 bool                            NotificationManager::mAutoSend = true;
+bool                            NotificationManager::mStaging  = false;
+size_t                          NotificationManager::mStagingThreshold = 64;
+NotificationManager::StickyMap  NotificationManager::mSticky;
+std::mutex                      NotificationManager::mStickyMutex;
+std::atomic<bool>               NotificationManager::mHasSticky { false };
+NotificationManager::TransportList NotificationManager::mTransports;
+NotificationManager::OldTransports NotificationManager::mOldTransports;
+std::mutex                      NotificationManager::mTransportMutex;
+std::atomic<bool>               NotificationManager::mHasTransports { false };
+NotificationManager::Throttles  NotificationManager::mThrottles;
+std::vector<NotificationManager::ThrottlePtr>   NotificationManager::mRetiredThrottles;
+std::vector<NotificationManager::Throttle *>    NotificationManager::mDebounced;
+std::mutex                      NotificationManager::mThrottleMutex;
+std::atomic<bool>               NotificationManager::mHasThrottles { false };
+std::atomic<bool>               NotificationManager::mHasDebounced { false };
+std::atomic<uint32_t>           NotificationManager::mThrottleVersion { 1 };
+thread_local NotificationManager::Pool          NotificationManager::mNotDataPool;
+thread_local NotificationManager::Staged        NotificationManager::mStaged;
+thread_local NotificationManager::ThrottleCache NotificationManager::mThrottleCache;
 
 //-------------------------------------
 void
 NotificationManager::SendNotification(NotificationId id, any data, bool overwrite) {
+    if (mHasThrottles && IsThrottled(id, data, overwrite, nullptr, kNoExpiry))
+        return;
+
+    SendUnthrottled(id, std::move(data), overwrite, nullptr, kNoExpiry);
+}
+
+//-------------------------------------
+void
+NotificationManager::SendNotificationWithTTL(NotificationId id, Duration ttl, any data, bool overwrite) {
+    int64_t expiry = GetExpiry(ttl);
+
+    if (mHasThrottles && IsThrottled(id, data, overwrite, nullptr, expiry))
+        return;
+
+    SendUnthrottled(id, std::move(data), overwrite, nullptr, expiry);
+}
+
+//-------------------------------------
+NotificationManager::SendHandle
+NotificationManager::SendCancellableNotification(NotificationId id, any data, bool overwrite) {
+    SendHandle handle;
+
+    handle.mCancelled = std::make_shared<std::atomic<bool>>(false);
+    if (mHasThrottles && IsThrottled(id, data, overwrite, handle.mCancelled, kNoExpiry))
+        return handle;
+
+    SendUnthrottled(id, std::move(data), overwrite, handle.mCancelled, kNoExpiry);
+
+    return handle;
+}
+
+//-------------------------------------
+void
+NotificationManager::SendUnthrottled(NotificationId id, any &&data, bool overwrite, const CancelFlag &cancelled, int64_t expiry) {
+    if (mHasSticky) {
+        UpdateSticky(id, data);
+    }
+
+    if (mHasTransports) {
+        TransportList transports = GetTransports();
+        if (transports != nullptr) {
+            for (auto *transport : *transports) {
+                transport->OnSend(id, data, overwrite);
+            }
+        }
+    }
+
     if(mAutoSend) {
         GetMutex().lock();
-            Map &notifications = mTIDNotifications[std::this_thread::get_id()];
-            const auto &it = notifications.find(id);
+            Subscriptions &subscriptions = GetThreadState(std::this_thread::get_id()).subscriptions;
+            Category      categories     = GetCategoriesUnsafe(id);
+            Group         *group         = GetGroupUnsafe(id);
+            // The members get it from the group, like the rest
+            bool          isMember       = group != nullptr && group->IsMember(std::this_thread::get_id());
         GetMutex().unlock();
 
-        if (it != notifications.end()) {
-            it->second(id, data);
+        if (isMember == false && subscriptions.Accepts(id, data)) {
+            subscriptions.Dispatch(id, categories, data);
         }
     }
 
     // Store it for the rest of the threads
-    StoreTIDData(id, data, overwrite);
+    if (mStaging) {
+        mStaged.push_back(StagedInfo { id, std::move(data), overwrite, cancelled, expiry });
+        if (mStaged.size() >= mStagingThreshold) {
+            Flush();
+        }
+        return;
+    }
+
+    // Staging was disabled by another thread: publish the leftovers first to keep the order
+    if (mStaged.empty() == false) {
+        Flush();
+    }
+
+    StoreTIDData(id, std::move(data), overwrite, false, cancelled, expiry);
+}
+
+//-------------------------------------
+bool
+NotificationManager::SendNotificationTo(TID tid, NotificationId id, any data, bool overwrite) {
+    bool isMe = mAutoSend && tid == std::this_thread::get_id();
+
+    GetMutex().lock();
+        const auto  &it         = mThreads.find(tid);
+        ThreadState *state      = it != mThreads.end() ? it->second.get() : nullptr;
+        Category    categories  = GetCategoriesUnsafe(id);
+        bool        isAccepted  = state != nullptr && state->subscriptions.IsSubscribed(id, categories) && state->subscriptions.Accepts(id, data);
+        if (isAccepted && isMe == false) {
+            StoreData(state->inbox[GetPhaseUnsafe(id)], id, categories, std::move(data), overwrite, nullptr, GetMergeUnsafe(id), GetExpiryUnsafe(id, kNoExpiry));
+        }
+    GetMutex().unlock();
+
+    if (isAccepted && isMe) {
+        state->subscriptions.Dispatch(id, categories, data);
+    }
+
+    return isAccepted;
+}
+
+//-------------------------------------
+void
+NotificationManager::SetStaging(bool set, size_t threshold) {
+    mStaging          = set;
+    mStagingThreshold = threshold > 0 ? threshold : 1;
+    if (set == false) {
+        Flush();
+    }
+}
+
+//-------------------------------------
+void
+NotificationManager::Flush() {
+    Flush(mStaged);
+}
+
+//-------------------------------------
+void
+NotificationManager::Flush(Staged &staged) {
+    if (staged.empty())
+        return;
+
+    GetMutex().lock();
+        for (auto &info : staged) {
+            StoreTIDDataUnsafe(info.id, std::move(info.data), info.overwrite, false, info.cancelled, info.expiry);
+        }
+    GetMutex().unlock();
+
+    staged.clear();
+}
+
+//-------------------------------------
+void
+NotificationManager::Deliver(NotificationId id, any data, bool overwrite) {
+    StoreTIDData(id, std::move(data), overwrite, true);
+}
+
+//-------------------------------------
+void
+NotificationManager::AddTransport(Transport *transport) {
+    const std::lock_guard<std::mutex> lock(mTransportMutex);
+
+    Transports transports = mTransports != nullptr ? *mTransports : Transports();
+    if (transport != nullptr && std::find(transports.begin(), transports.end(), transport) == transports.end()) {
+        transports.emplace_back(transport);
+        SetTransports(std::move(transports));
+    }
+}
+
+//-------------------------------------
+void
+NotificationManager::RemoveTransport(Transport *transport) {
+    OldTransports oldTransports;
+
+    {
+        const std::lock_guard<std::mutex> lock(mTransportMutex);
+
+        Transports transports = mTransports != nullptr ? *mTransports : Transports();
+        transports.erase(std::remove(transports.begin(), transports.end(), transport), transports.end());
+        SetTransports(std::move(transports));
+        oldTransports = mOldTransports;
+    }
+
+    // The senders and drains that took a snapshot before could still be calling it
+    for (const auto &old : oldTransports) {
+        while (old.expired() == false) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+//-------------------------------------
+// With mTransportMutex locked
+void
+NotificationManager::SetTransports(Transports &&transports) {
+    mOldTransports.erase(std::remove_if(mOldTransports.begin(), mOldTransports.end(),
+                                        [](const OldTransports::value_type &old) { return old.expired(); }), mOldTransports.end());
+    if (mTransports != nullptr) {
+        mOldTransports.emplace_back(mTransports);
+    }
+
+    // The senders read it without locking
+    std::atomic_store(&mTransports, transports.empty() ? TransportList() : std::make_shared<const Transports>(std::move(transports)));
+    mHasTransports = mTransports != nullptr;
+}
+
+//-------------------------------------
+NotificationManager::TransportList
+NotificationManager::GetTransports() {
+    return std::atomic_load(&mTransports);
+}
+
+//-------------------------------------
+NotificationManager::Response
+NotificationManager::SendRequest(NotificationId id, any data) {
+    Request     request;
+    Response    response;
+
+    request.mData  = std::move(data);
+    request.mState = std::make_shared<ReplyState>();
+    request.mState->requester = std::this_thread::get_id();
+    response.mState = request.mState;
+
+    SendNotification(id, std::move(request));
+
+    return response;
+}
+
+//-------------------------------------
+bool
+NotificationManager::Request::Reply(any value) const {
+    std::shared_ptr<ReplyState> state = mState;
+
+    {
+        const std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->isReady)
+            return false;
+
+        state->value   = std::move(value);
+        state->isReady = true;
+
+        // Posted before waking the requester, so its next drain already runs it
+        std::function<void(const any &)> continuation = std::move(state->continuation);
+        if (continuation != nullptr) {
+            PostTask(state->requester, [state, continuation]() { continuation(state->value); });
+        }
+    }
+    state->condition.notify_all();
+
+    return true;
+}
+
+//-------------------------------------
+bool
+NotificationManager::Response::IsReady() const {
+    const std::lock_guard<std::mutex> lock(mState->mutex);
+
+    return mState->isReady;
+}
+
+//-------------------------------------
+void
+NotificationManager::Response::Wait() const {
+    std::unique_lock<std::mutex> lock(mState->mutex);
+
+    const auto &state = mState;
+    mState->condition.wait(lock, [&state]() { return state->isReady; });
+}
+
+//-------------------------------------
+bool
+NotificationManager::Response::WaitFor(std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(mState->mutex);
+
+    const auto &state = mState;
+    return mState->condition.wait_for(lock, timeout, [&state]() { return state->isReady; });
+}
+
+//-------------------------------------
+const any &
+NotificationManager::Response::Get() const {
+    Wait();
+
+    return mState->value;
+}
+
+//-------------------------------------
+void
+NotificationManager::Response::Then(std::function<void(const any &)> continuation) {
+    std::shared_ptr<ReplyState> state = mState;
+
+    {
+        const std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->isReady == false) {
+            state->continuation = std::move(continuation);
+            return;
+        }
+    }
+
+    // Already replied: it will run on the next drain as well
+    PostTask(state->requester, [state, continuation]() { continuation(state->value); });
+}
+
+//-------------------------------------
+void
+NotificationManager::PostTask(TID tid, Task task) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    GetThreadState(tid).tasks.emplace_back(std::move(task));
+}
+
+//-------------------------------------
+NotificationManager::ThreadState &
+NotificationManager::GetThreadState(TID tid) {
+    std::unique_ptr<ThreadState> &state = mThreads[tid];
+
+    if (state == nullptr) {
+        state.reset(new ThreadState());
+    }
+
+    return *state;
 }
 
 //-------------------------------------
@@ -39,66 +362,852 @@ NotificationManager::Delegate &
 NotificationManager::GetDelegate(NotificationId id) {
     const std::lock_guard<std::mutex> lock(GetMutex());
 
-    return mTIDNotifications[std::this_thread::get_id()][id];
+    Delegate &delegate = GetThreadState(std::this_thread::get_id()).subscriptions.delegates[id];
+    delegate.mId    = id;
+    delegate.mHasId = true;
+
+    return delegate;
+}
+
+//-------------------------------------
+NotificationManager::Delegate &
+NotificationManager::GetCategoryDelegate(Category mask) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    Subscriptions &subscriptions = GetThreadState(std::this_thread::get_id()).subscriptions;
+    subscriptions.categoryMask |= mask;
+
+    for (const auto &pair : subscriptions.categoryDelegates) {
+        if (pair.first == mask)
+            return *pair.second;
+    }
+    subscriptions.categoryDelegates.emplace_back(mask, std::unique_ptr<Delegate>(new Delegate));
+
+    return *subscriptions.categoryDelegates.back().second;
+}
+
+//-------------------------------------
+void
+NotificationManager::SetFilter(NotificationId id, Filter filter) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    auto &filters = GetThreadState(std::this_thread::get_id()).subscriptions.filters;
+    if (filter != nullptr)
+        filters[id] = std::move(filter);
+    else
+        filters.erase(id);
+}
+
+//-------------------------------------
+void
+NotificationManager::JoinGroup(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+    TID                               tid = std::this_thread::get_id();
+
+    GroupPtr &group = mGroups[id];
+    if (group == nullptr) {
+        group = std::make_shared<Group>(id);
+    }
+
+    if (group->IsMember(tid) == false) {
+        group->members.emplace_back(tid);
+        GetThreadState(tid).groups.emplace_back(group);
+    }
+}
+
+//-------------------------------------
+void
+NotificationManager::LeaveGroup(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+    TID                               tid = std::this_thread::get_id();
+
+    const auto &it = mGroups.find(id);
+    if (it == mGroups.end())
+        return;
+
+    GroupPtr group = it->second;
+    auto &members = group->members;
+    members.erase(std::remove(members.begin(), members.end(), tid), members.end());
+    if (members.empty()) {
+        mGroups.erase(it);
+    }
+
+    GroupList &groups = GetThreadState(tid).groups;
+    groups.erase(std::remove(groups.begin(), groups.end(), group), groups.end());
+}
+
+//-------------------------------------
+NotificationManager::Group *
+NotificationManager::GetGroupUnsafe(NotificationId id) {
+    if (mGroups.empty())
+        return nullptr;
+
+    const auto &it = mGroups.find(id);
+    return it != mGroups.end() ? it->second.get() : nullptr;
+}
+
+//-------------------------------------
+bool
+NotificationManager::Group::IsMember(TID tid) const {
+    return std::find(members.begin(), members.end(), tid) != members.end();
+}
+
+//-------------------------------------
+void
+NotificationManager::SetCategories(NotificationId id, Category categories) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    mCategories[id] = categories;
+}
+
+//-------------------------------------
+NotificationManager::Category
+NotificationManager::GetCategories(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    return GetCategoriesUnsafe(id);
 }
 
 //-------------------------------------
 void
-NotificationManager::StoreTIDData(NotificationId id, const any &data, bool overwrite) {
-    const std::lock_guard<std::mutex>   lock(GetMutex());
-    bool                                found;
+NotificationManager::SetSticky(NotificationId id, bool set) {
+    const std::lock_guard<std::mutex> lock(GetStickyMutex());
+
+    if (set) {
+        mSticky.emplace(id, nullptr);
+    }
+    else {
+        mSticky.erase(id);
+    }
+    mHasSticky = mSticky.empty() == false;
+}
+
+//-------------------------------------
+bool
+NotificationManager::IsSticky(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(GetStickyMutex());
+
+    return mSticky.find(id) != mSticky.end();
+}
 
-    //for(const auto &[tid, notifications] : mTIDNotifications) {
-    for (const auto &pair : mTIDNotifications) {
+//-------------------------------------
+void
+NotificationManager::UpdateSticky(NotificationId id, const any &data) {
+    StickyValue value;
+
+    if (IsSticky(id) == false)
+        return;
+
+    // Copy the payload outside the lock, readers only copy the shared pointer
+    value = std::make_shared<const any>(data);
+
+    GetStickyMutex().lock();
+        const auto &it = mSticky.find(id);
+        if (it != mSticky.end()) {
+            std::swap(it->second, value);
+        }
+    GetStickyMutex().unlock();
+}
+
+//-------------------------------------
+NotificationManager::StickyValue
+NotificationManager::GetStickyValue(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(GetStickyMutex());
+
+    const auto &it = mSticky.find(id);
+    return it != mSticky.end() ? it->second : nullptr;
+}
+
+//-------------------------------------
+void
+NotificationManager::Delegate::OnAdded(const Wrapper &wrapper) {
+    if (mHasId && mHasSticky) {
+        StickyValue value = GetStickyValue(mId);
+        if (value != nullptr) {
+            wrapper(mId, *value);
+        }
+    }
+}
+
+//-------------------------------------
+void
+NotificationManager::SetRateLimit(NotificationId id, uint32_t count, Duration interval) {
+    ThrottlePtr throttle(new Throttle());
+
+    // Generic cell rate algorithm: a token bucket that only needs the time of the next token.
+    // Without count, the tolerance is negative and nothing is sent.
+    throttle->mode      = ThrottleMode::RateLimit;
+    throttle->interval  = count > 0 ? int64_t(interval.count()) / count : int64_t(interval.count());
+    throttle->tolerance = count > 0 ? int64_t(interval.count()) - throttle->interval : -1;
+    SetThrottle(id, std::move(throttle));
+}
+
+//-------------------------------------
+void
+NotificationManager::SetDebounce(NotificationId id, Duration interval, Edge edge) {
+    ThrottlePtr throttle(new Throttle());
+
+    throttle->mode     = edge == Edge::Leading ? ThrottleMode::Leading : ThrottleMode::Trailing;
+    throttle->interval = int64_t(interval.count());
+    SetThrottle(id, std::move(throttle));
+}
+
+//-------------------------------------
+void
+NotificationManager::SetSampling(NotificationId id, uint32_t oneOf) {
+    ThrottlePtr throttle(new Throttle());
+
+    throttle->mode  = ThrottleMode::Sampling;
+    throttle->oneOf = oneOf > 0 ? oneOf : 1;
+    SetThrottle(id, std::move(throttle));
+}
+
+//-------------------------------------
+void
+NotificationManager::RemoveThrottle(NotificationId id) {
+    SetThrottle(id, nullptr);
+}
+
+//-------------------------------------
+// The replaced policies are kept until Clear because a sender could be using them. A pending
+// Trailing payload of a replaced policy is still sent.
+void
+NotificationManager::SetThrottle(NotificationId id, ThrottlePtr throttle) {
+    const std::lock_guard<std::mutex> lock(GetThrottleMutex());
+
+    const auto &it = mThrottles.find(id);
+    if (it != mThrottles.end()) {
+        mRetiredThrottles.emplace_back(std::move(it->second));
+        mThrottles.erase(it);
+    }
+
+    if (throttle != nullptr) {
+        throttle->id = id;
+        mThrottles.emplace(id, std::move(throttle));
+    }
+
+    ++mThrottleVersion;
+    mHasThrottles = mThrottles.empty() == false;
+}
+
+//-------------------------------------
+NotificationManager::Throttle *
+NotificationManager::FindThrottle(NotificationId id) {
+    uint32_t version = mThrottleVersion.load(std::memory_order_acquire);
+
+    if (mThrottleCache.version != version) {
+        const std::lock_guard<std::mutex> lock(GetThrottleMutex());
+
+        mThrottleCache.throttles.clear();
+        for (const auto &pair : mThrottles) {
+            mThrottleCache.throttles.emplace(pair.first, pair.second.get());
+        }
+        mThrottleCache.version = mThrottleVersion;
+    }
+
+    const auto &it = mThrottleCache.throttles.find(id);
+    return it != mThrottleCache.throttles.end() ? it->second : nullptr;
+}
+
+//-------------------------------------
+bool
+NotificationManager::IsThrottled(NotificationId id, any &data, bool overwrite, const CancelFlag &cancelled, int64_t expiry) {
+    Throttle *throttle = FindThrottle(id);
+
+    if (throttle == nullptr)
+        return false;
+
+    switch (throttle->mode) {
+        case ThrottleMode::RateLimit: {
+            int64_t now  = GetTime();
+            int64_t time = throttle->time.load(std::memory_order_relaxed);
+            int64_t next;
+            do {
+                next = std::max(time, now);
+                if (next - now > throttle->tolerance)
+                    return true;
+            } while (throttle->time.compare_exchange_weak(time, next + throttle->interval, std::memory_order_relaxed) == false);
+            return false;
+        }
+
+        // Every send restarts the interval, so only the first one of a burst passes
+        case ThrottleMode::Leading: {
+            int64_t now  = GetTime();
+            int64_t last = throttle->time.exchange(now, std::memory_order_relaxed);
+            return last != kNever && now - last < throttle->interval;
+        }
+
+        case ThrottleMode::Trailing: {
+            int64_t now = GetTime();
+            const std::lock_guard<std::mutex> lock(GetThrottleMutex());
+            throttle->pending          = std::move(data);
+            throttle->pendingOverwrite = overwrite;
+            throttle->pendingCancelled = cancelled;
+            throttle->pendingExpiry    = expiry;
+            throttle->deadline         = now + throttle->interval;
+            if (throttle->hasPending == false) {
+                throttle->hasPending = true;
+                mDebounced.emplace_back(throttle);
+                mHasDebounced = true;
+            }
+            return true;
+        }
+
+        case ThrottleMode::Sampling:
+            return throttle->counter.fetch_add(1, std::memory_order_relaxed) % throttle->oneOf != 0;
+    }
+
+    return false;
+}
+
+//-------------------------------------
+void
+NotificationManager::ReleaseDebounced() {
+    Staged  released;
+    int64_t now = GetTime();
+
+    GetThrottleMutex().lock();
+        for (size_t i = 0; i < mDebounced.size(); ) {
+            Throttle *throttle = mDebounced[i];
+            if (throttle->deadline <= now) {
+                released.push_back(StagedInfo { throttle->id, std::move(throttle->pending), throttle->pendingOverwrite, std::move(throttle->pendingCancelled), throttle->pendingExpiry });
+                throttle->pending    = any();
+                throttle->hasPending = false;
+                mDebounced[i] = mDebounced.back();
+                mDebounced.pop_back();
+            }
+            else {
+                ++i;
+            }
+        }
+        mHasDebounced = mDebounced.empty() == false;
+    GetThrottleMutex().unlock();
+
+    for (auto &info : released) {
+        if (info.cancelled == nullptr || *info.cancelled == false) {
+            SendUnthrottled(info.id, std::move(info.data), info.overwrite, info.cancelled, info.expiry);
+        }
+    }
+}
+
+//-------------------------------------
+int64_t
+NotificationManager::GetTime() {
+    return int64_t(std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//-------------------------------------
+void
+NotificationManager::SetMerge(NotificationId id, Merge merge) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    if (merge != nullptr)
+        mMerges[id] = std::move(merge);
+    else
+        mMerges.erase(id);
+}
+
+//-------------------------------------
+void
+NotificationManager::SetTTL(NotificationId id, Duration ttl) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    if (ttl > Duration::zero())
+        mTTLs[id] = ttl;
+    else
+        mTTLs.erase(id);
+}
+
+//-------------------------------------
+NotificationManager::Duration
+NotificationManager::GetTTL(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    const auto &it = mTTLs.find(id);
+    return it != mTTLs.end() ? it->second : Duration::zero();
+}
+
+//-------------------------------------
+int64_t
+NotificationManager::GetExpiryUnsafe(NotificationId id, int64_t expiry) {
+    if (expiry != kNoExpiry || mTTLs.empty())
+        return expiry;
+
+    const auto &it = mTTLs.find(id);
+    return it != mTTLs.end() ? GetExpiry(it->second) : kNoExpiry;
+}
+
+//-------------------------------------
+int64_t
+NotificationManager::GetExpiry(Duration ttl) {
+    if (ttl <= Duration::zero())
+        return kNoExpiry;
+
+    int64_t now = GetTime();
+    if (int64_t(ttl.count()) >= kNoExpiry - now)
+        return kNoExpiry;
+
+    return now + int64_t(ttl.count());
+}
+
+//-------------------------------------
+const NotificationManager::Merge *
+NotificationManager::GetMergeUnsafe(NotificationId id) {
+    if (mMerges.empty())
+        return nullptr;
+
+    const auto &it = mMerges.find(id);
+    return it != mMerges.end() ? &it->second : nullptr;
+}
+
+//-------------------------------------
+NotificationManager::Category
+NotificationManager::GetCategoriesUnsafe(NotificationId id) {
+    const auto &it = mCategories.find(id);
+
+    return it != mCategories.end() ? it->second : Category(0);
+}
+
+//-------------------------------------
+bool
+NotificationManager::SetPhase(NotificationId id, Phase phase) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    if (phase >= kNumPhases)
+        return false;
+
+    if (phase == kDefaultPhase) {
+        mPhases.erase(id);
+    }
+    else {
+        mPhases[id] = phase;
+    }
+
+    return true;
+}
+
+//-------------------------------------
+NotificationManager::Phase
+NotificationManager::GetPhase(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    return GetPhaseUnsafe(id);
+}
+
+//-------------------------------------
+NotificationManager::Phase
+NotificationManager::GetPhaseUnsafe(NotificationId id) {
+    if (mPhases.empty())
+        return kDefaultPhase;
+
+    const auto &it = mPhases.find(id);
+    return it != mPhases.end() ? it->second : kDefaultPhase;
+}
+
+//-------------------------------------
+void
+NotificationManager::StoreTIDData(NotificationId id, any &&data, bool overwrite, bool includeMe, const CancelFlag &cancelled, int64_t expiry) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    StoreTIDDataUnsafe(id, std::move(data), overwrite, includeMe, cancelled, expiry);
+}
+
+//-------------------------------------
+void
+NotificationManager::StoreTIDDataUnsafe(NotificationId id, any &&data, bool overwrite, bool includeMe, const CancelFlag &cancelled, int64_t expiry) {
+    NotData                             *last = nullptr;
+    Category                            categories = GetCategoriesUnsafe(id);
+    Phase                               phase      = GetPhaseUnsafe(id);
+    Group                               *group     = GetGroupUnsafe(id);
+    const Merge                         *merge     = GetMergeUnsafe(id);
+
+    expiry = GetExpiryUnsafe(id, expiry);
+
+    //for(const auto &[tid, state] : mThreads) {
+    for (const auto &pair : mThreads) {
         const auto &tid           = pair.first;
-        const auto &notifications = pair.second;
-        if(mAutoSend && tid == std::this_thread::get_id())
+        const auto &subscriptions = pair.second->subscriptions;
+        if(mAutoSend && includeMe == false && tid == std::this_thread::get_id())
+            continue;
+        if (group != nullptr && group->IsMember(tid))
             continue;
 
-        // is 'notification id' registered for this 'thread id'?
-        if(notifications.find(id) != notifications.end()) {
-            found = false;
-            if (overwrite) {
-                auto    &notData = mTIDData[tid];
-                size_t  size = notData.size();
-                for (size_t i = 0; i < size; ++i) {
-                    if (notData[i].first == id) {
-                        notData[i].second = data;
-                        found = true;
-                        break;
-                    }
-                }
+        // is 'notification id' (or one of its categories) registered for this 'thread id'?
+        if(subscriptions.IsSubscribed(id, categories) && subscriptions.Accepts(id, data)) {
+            // Every recipient but the last one gets a copy
+            if (last != nullptr) {
+                StoreData(*last, id, categories, data, overwrite, cancelled, merge, expiry);
             }
+            last = &pair.second->inbox[phase];
+        }
+    }
+
+    if (group != nullptr) {
+        if (last != nullptr) {
+            StoreData(*last, id, categories, data, overwrite, cancelled, merge, expiry);
+        }
+        NotInfo info { id, categories, std::move(data), cancelled, expiry };
+        if (group->queue.TryPush(std::move(info)) == false) {
+            TID tid = group->members[group->next++ % group->members.size()];
+            GetThreadState(tid).inbox[phase].push_back(std::move(info));
+        }
+        return;
+    }
 
-            if((overwrite | found) == false) {
-                mTIDData[tid].emplace_back(std::pair<NotificationId, any>(id, data));
+    // The last one can steal the payload
+    if (last != nullptr) {
+        StoreData(*last, id, categories, std::move(data), overwrite, cancelled, merge, expiry);
+    }
+}
+
+//-------------------------------------
+template <typename Data>
+void
+NotificationManager::StoreData(NotData &notData, NotificationId id, Category categories, Data &&data, bool overwrite, const CancelFlag &cancelled, const Merge *merge, int64_t expiry) {
+    if (merge != nullptr) {
+        for (auto &info : notData) {
+            // Cancelling one of the merged sends would drop the rest
+            if (info.id == id && info.IsCancelled() == false) {
+                (*merge)(info.data, data);
+                info.cancelled = nullptr;
+                info.expiry    = std::max(info.expiry, expiry);
+                return;
+            }
+        }
+    }
+    else if (overwrite) {
+        for (auto &info : notData) {
+            if (info.id == id) {
+                info.data      = std::forward<Data>(data);
+                info.cancelled = cancelled;
+                info.expiry    = expiry;
+                return;
             }
         }
     }
+
+    notData.push_back(NotInfo { id, categories, std::forward<Data>(data), cancelled, expiry });
 }
 
 //-------------------------------------
 void
 NotificationManager::SendStoredNotificationsForThisThread() {
-    // Get my notification data
+    SendStoredNotifications(0, kNumPhases);
+}
+
+//-------------------------------------
+void
+NotificationManager::SendStoredNotificationsForThisThread(Phase phase) {
+    if (phase < kNumPhases) {
+        SendStoredNotifications(phase, phase + 1);
+    }
+}
+
+//-------------------------------------
+void
+NotificationManager::SendStoredNotifications(Phase first, Phase last) {
+    if (mHasDebounced) {
+        ReleaseDebounced();
+    }
+
+    // Publish what this thread has sent before receiving
+    if (mStaged.empty() == false) {
+        Flush();
+    }
+
+    if (mHasTransports) {
+        TransportList transports = GetTransports();
+        if (transports != nullptr) {
+            for (auto *transport : *transports) {
+                transport->Poll();
+            }
+        }
+    }
+
+    // Swap my notification data with recycled buffers, so both keep their capacity
+    Inbox                               notData;
+    Tasks                               tasks;
+    std::array<GroupList, kNumPhases>   groups;
     GetMutex().lock();
-        NotData notData = std::move(mTIDData[std::this_thread::get_id()]);
+        ThreadState   &state         = GetThreadState(std::this_thread::get_id());
+        Subscriptions &subscriptions = state.subscriptions;
+        for (Phase phase = first; phase < last; ++phase) {
+            if (state.inbox[phase].empty() == false) {
+                notData[phase] = AcquireNotData();
+                std::swap(notData[phase], state.inbox[phase]);
+            }
+        }
+        std::swap(tasks, state.tasks);
+        // A handler could leave the group, so keep them alive
+        for (const auto &group : state.groups) {
+            Phase phase = GetPhaseUnsafe(group->id);
+            if (phase >= first && phase < last) {
+                groups[phase].emplace_back(group);
+            }
+        }
     GetMutex().unlock();
 
-    auto &notifications = mTIDNotifications[std::this_thread::get_id()];
-    //for(auto &[id, data] : notData) {
-    for (const auto &pair : notData) {
-        const auto &id   = pair.first;
-        const auto &data = pair.second;
-        notifications[id](id,  data);
+    int64_t now = 0;
+    for (Phase phase = first; phase < last; ++phase) {
+        if (notData[phase].empty() == false) {
+            for (const auto &info : notData[phase]) {
+                if (info.IsCancelled() == false && info.IsExpired(now) == false) {
+                    subscriptions.Dispatch(info.id, info.categories, info.data);
+                }
+            }
+            ReleaseNotData(std::move(notData[phase]));
+        }
+
+        // One by one, so the other members can take the next ones while this one is busy.
+        // Up to the capacity, as the senders could keep the queue busy forever.
+        for (const auto &group : groups[phase]) {
+            NotInfo info {};
+            for (size_t i = 0; i < kGroupCapacity && group->queue.TryPop(info); ++i) {
+                if (info.IsCancelled() == false && info.IsExpired(now) == false) {
+                    subscriptions.Dispatch(info.id, info.categories, info.data);
+                }
+            }
+        }
+    }
+
+    for (const auto &task : tasks) {
+        task();
     }
 }
 
+//-------------------------------------
+size_t
+NotificationManager::TrimExpired() {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+    int64_t                           now   = GetTime();
+    size_t                            count = 0;
+
+    for (const auto &pair : mThreads) {
+        for (auto &notData : pair.second->inbox) {
+            size_t size = notData.size();
+            notData.erase(std::remove_if(notData.begin(), notData.end(), [now](const NotInfo &info) { return info.expiry <= now; }), notData.end());
+            count += size - notData.size();
+        }
+    }
+
+    return count;
+}
+
+//-------------------------------------
+bool
+NotificationManager::NotInfo::IsExpired(int64_t &now) const {
+    if (expiry == kNoExpiry)
+        return false;
+
+    if (now == 0) {
+        now = GetTime();
+    }
+
+    return expiry <= now;
+}
+
+//-------------------------------------
+NotificationManager::NotData
+NotificationManager::AcquireNotData() {
+    NotData notData;
+
+    // A handler could call SendStoredNotificationsForThisThread again, so we keep a pool instead of a single buffer
+    if (mNotDataPool.empty() == false) {
+        notData = std::move(mNotDataPool.back());
+        mNotDataPool.pop_back();
+    }
+
+    return notData;
+}
+
+//-------------------------------------
+void
+NotificationManager::ReleaseNotData(NotData &&notData) {
+    notData.clear();
+    mNotDataPool.emplace_back(std::move(notData));
+}
+
 //-------------------------------------
 void
 NotificationManager::Clear() {
-    const std::lock_guard<std::mutex>   lock(GetMutex());
+    mStaged.clear();    // Only the ones of this thread
+
+    {
+        const std::lock_guard<std::mutex>   lock(GetMutex());
+
+        mThreads.clear();
+        mCategories.clear();
+        mPhases.clear();
+        mGroups.clear();
+        mMerges.clear();
+        mTTLs.clear();
+    }
+
+    {
+        const std::lock_guard<std::mutex>   throttleLock(GetThrottleMutex());
+
+        mThrottles.clear();
+        mRetiredThrottles.clear();
+        mDebounced.clear();
+        mHasThrottles = false;
+        mHasDebounced = false;
+        ++mThrottleVersion;
+    }
 
-    mTIDNotifications.clear();
-    mTIDData.clear();
+    // Without MT, GetStickyMutex returns the same mutex as GetMutex, so they cannot be nested
+    const std::lock_guard<std::mutex>   stickyLock(GetStickyMutex());
+    mSticky.clear();
+    mHasSticky = false;
 }
+
+//-------------------------------------
+bool
+NotificationManager::Subscriptions::IsSubscribed(NotificationId id, Category categories) const {
+    if ((categoryMask & categories) != 0 || delegates.find(id) != delegates.end())
+        return true;
+
+#if NOTIFICATIONS_COROUTINES
+    if (awaiters.empty() == false) {
+        const auto &it = awaiters.find(id);
+        return it != awaiters.end() && it->second != nullptr;
+    }
+#endif
+
+    return false;
+}
+
+//-------------------------------------
+bool
+NotificationManager::Subscriptions::Accepts(NotificationId id, const any &data) const {
+    if (filters.empty())
+        return true;
+
+    const auto &it = filters.find(id);
+    return it == filters.end() || it->second(id, data);
+}
+
+//-------------------------------------
+void
+NotificationManager::Subscriptions::Dispatch(NotificationId id, Category categories, const any &data) {
+    const auto &it = delegates.find(id);
+    if (it != delegates.end()) {
+        it->second(id, data);
+    }
+
+    // Bulk subscriptions: one bitwise test per category delegate.
+    // By index, as a handler can add category delegates (they get the next notifications).
+    if ((categoryMask & categories) != 0) {
+        for (size_t i = 0, size = categoryDelegates.size(); i < size; ++i) {
+            Delegate *delegate = categoryDelegates[i].second.get();
+            if ((categoryDelegates[i].first & categories) != 0) {
+                (*delegate)(id, data);
+            }
+        }
+    }
+
+#if NOTIFICATIONS_COROUTINES
+    if (awaiters.empty() == false) {
+        Resume(id, data);
+    }
+#endif
+}
+
+#if NOTIFICATIONS_COROUTINES
+
+//-------------------------------------
+void
+NotificationManager::Subscriptions::Resume(NotificationId id, const any &data) {
+    Awaiter *list = nullptr;
+
+    GetMutex().lock();
+        const auto &it = awaiters.find(id);
+        if (it != awaiters.end()) {
+            // Detach them, so the resumed coroutines can wait again for the next one
+            // Reverse the list to resume them in the order they were suspended
+            for (Awaiter *awaiter = it->second; awaiter != nullptr; ) {
+                Awaiter *next = awaiter->mNext;
+                awaiter->mNext      = list;
+                awaiter->mIsWaiting = false;
+                list = awaiter;
+                awaiter = next;
+            }
+            it->second = nullptr;
+        }
+    GetMutex().unlock();
+
+    while (list != nullptr) {
+        Awaiter *awaiter = list;
+        list = awaiter->mNext;
+        awaiter->mNext = nullptr;
+        awaiter->mData = data;
+        awaiter->mHandle.resume();
+    }
+}
+
+//-------------------------------------
+void
+NotificationManager::Awaiter::await_suspend(std::coroutine_handle<> handle) {
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    mHandle    = handle;
+    mTID       = std::this_thread::get_id();
+    mIsWaiting = true;
+
+    Awaiter *&head = GetThreadState(mTID).subscriptions.awaiters[mId];
+    mNext = head;
+    head  = this;
+}
+
+//-------------------------------------
+NotificationManager::Awaiter::~Awaiter() {
+    if (mIsWaiting == false)
+        return;
+
+    // The coroutine was destroyed while suspended
+    const std::lock_guard<std::mutex> lock(GetMutex());
+
+    const auto &it = mThreads.find(mTID);
+    if (it != mThreads.end()) {
+        Awaiter **link = &it->second->subscriptions.awaiters[mId];
+        while (*link != nullptr && *link != this) {
+            link = &(*link)->mNext;
+        }
+        if (*link == this) {
+            *link = mNext;
+        }
+    }
+}
+
+//-------------------------------------
+NotificationStream::NotificationStream(NotificationId id) : mId(id) {
+    mCallableId = NotificationManager::GetDelegate(id).Add([this](NotificationId, const any &data) { Push(data); });
+}
+
+//-------------------------------------
+NotificationStream::~NotificationStream() {
+    NotificationManager::GetDelegate(mId).RemoveById(mCallableId);
+}
+
+//-------------------------------------
+void
+NotificationStream::Push(const any &data) {
+    mQueue.push_back(data);
+
+    if (mWaiting) {
+        std::coroutine_handle<> handle = mWaiting;
+        mWaiting = nullptr;
+        handle.resume();
+    }
+}
+
+//-------------------------------------
+any
+NotificationStream::Awaiter::await_resume() {
+    any data = std::move(mStream.mQueue.front());
+
+    mStream.mQueue.pop_front();
+
+    return data;
+}
+
+#endif
@@ -7,11 +7,29 @@
 // See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
 //-----------------------------------------------------------------------------
 
+#include <cstdint>
+#include <limits>
+#include <array>
 #include <vector>
+#include <functional>
+#include <memory>
+#include <atomic>
 #include <unordered_map>
 #include <thread>
 #include <mutex>
-#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <chrono>
+// Define NOTIFICATIONS_SMALL_ANY_CAPACITY (in bytes) to use a payload type with an inline buffer
+// that avoids the heap allocations of any for payloads up to that size.
+// any relies on RTTI for its type checks, so SmallAny is used by default when RTTI is disabled.
+#if !defined(NOTIFICATIONS_SMALL_ANY_CAPACITY) && !defined(__GXX_RTTI) && !defined(_CPPRTTI)
+    #define NOTIFICATIONS_SMALL_ANY_CAPACITY    64
+#endif
+#if defined(NOTIFICATIONS_SMALL_ANY_CAPACITY)
+    #include "SmallAny.h"
+    using any = MindShake::SmallAny<NOTIFICATIONS_SMALL_ANY_CAPACITY>;
+    using MindShake::any_cast;
+    using MindShake::bad_any_cast;
+#elif __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
     #include <any>
     using std::any;
     using std::any_cast;
@@ -22,8 +40,25 @@
     using linb::any_cast;
     using linb::bad_any_cast;
 #endif
+// C++20 coroutines: co_await NotificationManager::Next(id) and NotificationStream
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+    #include <coroutine>
+    #include <deque>
+    #define NOTIFICATIONS_COROUTINES    1
+#else
+    #define NOTIFICATIONS_COROUTINES    0
+#endif
+// Number of queues per thread (see NotificationManager::SetPhase)
+#if !defined(NOTIFICATIONS_NUM_PHASES)
+    #define NOTIFICATIONS_NUM_PHASES    4
+#endif
+// Notifications that the queue of a group can hold (see NotificationManager::JoinGroup)
+#if !defined(NOTIFICATIONS_GROUP_CAPACITY)
+    #define NOTIFICATIONS_GROUP_CAPACITY    1024
+#endif
 //-------------------------------------
 #include "Delegate.h"
+#include "BoundedQueue.h"
 
 //-------------------------------------
 namespace MindShake {
@@ -42,8 +77,125 @@ namespace MindShake {
     //-------------------------------------
     class NotificationManager {
         public:
-            using Delegate = MindShake::Delegate<void(NotificationId, const any &)>;
+            class Delegate : public MindShake::Delegate<void(NotificationId, const any &)> {
+                protected:
+                    // Delivers the current value of sticky ids to the new callable
+                    void            OnAdded(const Wrapper &wrapper) override;
+
+                protected:
+                    friend class NotificationManager;
+
+                    NotificationId  mId {};
+                    bool            mHasId = false;
+            };
+
             using TID      = std::thread::id;
+            using Category = uint64_t;     // Bitmask of user defined categories
+            using Filter   = std::function<bool(NotificationId, const any &)>;
+            using Merge    = std::function<void(any &pending, const any &data)>;
+            using Task     = std::function<void()>;
+            using Phase    = uint32_t;     // User defined drain phase [0, kNumPhases)
+            using Duration = std::chrono::nanoseconds;
+
+            enum class Edge { Leading, Trailing };
+
+            static constexpr Phase kNumPhases   = NOTIFICATIONS_NUM_PHASES;
+            static constexpr Phase kDefaultPhase = 0;
+
+            // Extension point to exchange notifications with the outside (i.e. other processes).
+            // OnSend and Poll can be called concurrently from several threads.
+            class Transport {
+                public:
+                    virtual         ~Transport() = default;
+
+                    // Called by SendNotification on the sending thread
+                    virtual void    OnSend(NotificationId id, const any &data, bool overwrite) = 0;
+                    // Called at the beginning of SendStoredNotificationsForThisThread. Use Deliver for the incoming notifications.
+                    virtual void    Poll()  { }
+            };
+
+        protected:
+            struct ReplyState;
+
+            using CancelFlag = std::shared_ptr<std::atomic<bool>>;
+
+        public:
+            // Returned by SendCancellableNotification. Cancel drops the notification for every recipient
+            // that has not dispatched it yet (AutoSend dispatches it to the sending thread right away).
+            class SendHandle {
+                public:
+                    bool            IsValid() const     { return mCancelled != nullptr; }
+                    // Returns false if it was already cancelled
+                    bool            Cancel() const      { return mCancelled != nullptr && mCancelled->exchange(true) == false; }
+                    bool            IsCancelled() const { return mCancelled != nullptr && mCancelled->load(); }
+
+                protected:
+                    friend class NotificationManager;
+
+                    CancelFlag      mCancelled;
+            };
+
+            // Payload received by the handlers of a request (any_cast<const NotificationManager::Request &>(data)).
+            // Any of them can reply, but only the first reply is kept.
+            class Request {
+                public:
+                    const any &     GetData() const     { return mData; }
+                    bool            Reply(any value) const;
+
+                protected:
+                    friend class NotificationManager;
+
+                    any                         mData;
+                    std::shared_ptr<ReplyState> mState;
+            };
+
+            // Lightweight future returned by SendRequest.
+            class Response {
+                public:
+                    bool            IsValid() const     { return mState != nullptr; }
+                    bool            IsReady() const;
+                    void            Wait() const;
+                    bool            WaitFor(std::chrono::milliseconds timeout) const;
+                    // Waits for the reply
+                    const any &     Get() const;
+                    // The continuation is called on the requesting thread, during its next
+                    // SendStoredNotificationsForThisThread after the reply arrives.
+                    void            Then(std::function<void(const any &)> continuation);
+
+                protected:
+                    friend class NotificationManager;
+
+                    std::shared_ptr<ReplyState> mState;
+            };
+
+    #if NOTIFICATIONS_COROUTINES
+        public:
+            // Awaitable returned by Next. It is resumed with the payload during the next
+            // SendStoredNotificationsForThisThread (of the awaiting thread) that receives 'id'.
+            // It lives in the coroutine frame, so awaiting does not allocate.
+            class Awaiter {
+                public:
+                    explicit        Awaiter(NotificationId id) : mId(id) { }
+                                    Awaiter(const Awaiter &) = delete;
+                                    ~Awaiter();
+
+                    bool            await_ready() const noexcept    { return false;             }
+                    void            await_suspend(std::coroutine_handle<> handle);
+                    any             await_resume()                  { return std::move(mData);  }
+
+                protected:
+                    friend class NotificationManager;
+
+                    NotificationId          mId;
+                    std::coroutine_handle<> mHandle {};
+                    any                     mData;
+                    TID                     mTID;
+                    Awaiter                 *mNext {};
+                    bool                    mIsWaiting = false;
+            };
+
+            static Awaiter      Next(NotificationId id)     { return Awaiter(id); }
+    #endif
 
         public:
             static constexpr unsigned int   major = 1;
@@ -52,9 +204,49 @@ namespace MindShake {
 
         public:
             static Delegate &   GetDelegate(NotificationId id);
+            // Receives every notification whose categories intersect the mask
+            static Delegate &   GetCategoryDelegate(Category mask);
+            // The calling thread competes with the rest of members of the group of 'id': every notification of 'id'
+            // is dispatched by only one of them, the first one to take it during its SendStoredNotificationsForThisThread.
+            // The threads out of the group still get their own copy. Overwrite does not apply to the group.
+            static void         JoinGroup(NotificationId id);
+            // The pending notifications of the group are discarded when its last member leaves
+            static void         LeaveGroup(NotificationId id);
+            // Predicate evaluated by the sender (with the manager locked) before queuing 'id' for the current thread.
+            // Rejected notifications are not copied, queued nor dispatched. Pass nullptr to remove it.
+            static void         SetFilter(NotificationId id, Filter filter);
+            // The payload is moved into the last recipient, so pass rvalues to avoid copies
             static void         SendNotification(NotificationId id, any data = int(0), bool overwrite = false);
+            // Same, but the notification can be cancelled while it is pending (i.e. a path query for a unit that died)
+            static SendHandle   SendCancellableNotification(NotificationId id, any data = int(0), bool overwrite = false);
+            // Same, but it is discarded if it is still pending after 'ttl' (instead of the TTL of the id).
+            // As with SetTTL, a 'ttl' <= 0 means no TTL (the one of the id applies then).
+            static void         SendNotificationWithTTL(NotificationId id, Duration ttl, any data = int(0), bool overwrite = false);
+            // Constructs the payload in place and moves it through the send path
+            template <typename T, typename ...Args>
+            static void         EmplaceNotification(NotificationId id, Args &&...args);
+            // Sends it only to 'tid' (i.e. the render thread): one lookup and its queue, without visiting the rest of threads.
+            // Transports, sticky values, throttling, staging and groups do not apply.
+            // Returns false if 'tid' is not subscribed to 'id' (or its filter rejects it).
+            static bool         SendNotificationTo(TID tid, NotificationId id, any data = int(0), bool overwrite = false);
+
+            // Sends a Request with 'data' as payload. Do not Wait on the requesting thread for handlers of that same thread.
+            static Response     SendRequest(NotificationId id, any data = int(0));
 
+            // Dispatches the pending notifications of every phase (in phase order)
             static void         SendStoredNotificationsForThisThread();
+            // Dispatches only the pending notifications of 'phase'
+            static void         SendStoredNotificationsForThisThread(Phase phase);
+            // Frees the expired notifications pending for every thread (the drain skips them anyway), i.e. periodically
+            // from the main thread while some consumer is paused. Returns how many were freed. Groups are not trimmed.
+            static size_t       TrimExpired();
+
+            // Queues a notification for every subscribed thread (including this one), without going through the transports
+            static void         Deliver(NotificationId id, any data, bool overwrite = false);
+
+            static void         AddTransport(Transport *transport);
+            // Waits until no thread is calling it anymore, so do not call it from a transport
+            static void         RemoveTransport(Transport *transport);
 
         // Configuration
         public:
@@ -74,6 +266,51 @@ namespace MindShake {
             static void         DisableAutoSend()       { mAutoSend = false; }
             static bool         GetAutoSend()           { return mAutoSend;  }
 
+            // Stage the notifications sent by each thread (for the rest of threads) and publish them in bulk,
+            // locking the manager once per batch: on Flush, when the thread has 'threshold' of them,
+            // at its own SendStoredNotificationsForThisThread, or when the thread ends.
+            // Disabling it flushes only the calling thread; the rest publish their leftovers on their next send.
+            static void         SetStaging(bool set, size_t threshold = 64);
+            static bool         GetStaging()            { return mStaging;   }
+            // Publishes the notifications staged by the current thread
+            static void         Flush();
+
+            // Categories of a notification id (bitmask), used by the category delegates.
+            static void         SetCategories(NotificationId id, Category categories);
+            static Category     GetCategories(NotificationId id);
+
+            // Phase whose queue receives the notifications of an id (kDefaultPhase by default).
+            // Returns false if the phase is not below kNumPhases.
+            static bool         SetPhase(NotificationId id, Phase phase);
+            static Phase        GetPhase(NotificationId id);
+
+            // The manager keeps the last payload sent for sticky ids, and delivers it once
+            // (on the subscribing thread) to every callable added to GetDelegate(id) afterwards.
+            static void         SetSticky(NotificationId id, bool set);
+            static bool         IsSticky(NotificationId id);
+
+            // Combines every new payload of an id into the one already pending in each queue (i.e. summing
+            // damage or joining dirty rects), so a burst is dispatched once. Evaluated by the senders with the
+            // manager locked, so it must be cheap and thread-safe. Pass nullptr to remove it.
+            // Merged notifications cannot be cancelled. Groups and Trailing debounces do not merge.
+            static void         SetMerge(NotificationId id, Merge merge);
+
+            // Pending notifications of an id older than 'ttl' are discarded instead of dispatched.
+            // The time is taken when they are queued. Pass a duration <= 0 to remove it (Duration::max() never expires).
+            static void         SetTTL(NotificationId id, Duration ttl);
+            static Duration     GetTTL(NotificationId id);
+
+            // Throttling of the notifications sent for an id, checked by SendNotification before anything
+            // else (one policy per id: setting one replaces the previous one). Deliver is not throttled.
+            //     RateLimit: at most 'count' every 'interval' (token bucket: bursts of up to 'count').
+            //     Debounce:  Leading sends the first one of each burst. Trailing sends the last one once the id
+            //                has been quiet for 'interval', on the next SendStoredNotificationsForThisThread of any thread.
+            //     Sampling:  sends one of every 'oneOf'.
+            static void         SetRateLimit(NotificationId id, uint32_t count, Duration interval);
+            static void         SetDebounce(NotificationId id, Duration interval, Edge edge = Edge::Trailing);
+            static void         SetSampling(NotificationId id, uint32_t oneOf);
+            static void         RemoveThrottle(NotificationId id);
+
         // Finalize
         public:
             static void         Clear();
@@ -82,7 +319,173 @@ namespace MindShake {
             static std::mutex & GetMutex()  { return mEnableMT ? mMutex : mFakeMutex; }
 
         protected:
-            static void         StoreTIDData(NotificationId id, const any &data, bool overwrite);
+            static constexpr int64_t kNoExpiry = std::numeric_limits<int64_t>::max();
+
+            struct NotInfo {
+                bool            IsCancelled() const { return cancelled != nullptr && cancelled->load(std::memory_order_relaxed); }
+                // The clock is read only for the first entry that expires ('now' starts at 0)
+                bool            IsExpired(int64_t &now) const;
+
+                NotificationId  id;
+                Category        categories;
+                any             data;
+                CancelFlag      cancelled;      // Only for cancellable sends
+                int64_t         expiry;         // steady_clock ns, or kNoExpiry
+            };
+
+            using NotData      = std::vector<NotInfo>;
+            using Map          = std::unordered_map<NotificationId, Delegate>;
+            // Few of them, and a handler can add more while they are being called (see Dispatch)
+            using CategoryList = std::vector<std::pair<Category, std::unique_ptr<Delegate>>>;
+            using FilterMap    = std::unordered_map<NotificationId, Filter>;
+
+            struct StagedInfo {
+                NotificationId  id;
+                any             data;
+                bool            overwrite;
+                CancelFlag      cancelled;
+                int64_t         expiry;
+            };
+
+            // Publishes the leftovers when its thread ends
+            struct Staged : std::vector<StagedInfo> {
+                                ~Staged()               { Flush(*this); }
+            };
+
+            struct Subscriptions {
+                bool            IsSubscribed(NotificationId id, Category categories) const;
+                bool            Accepts(NotificationId id, const any &data) const;
+                void            Dispatch(NotificationId id, Category categories, const any &data);
+
+                Map             delegates;
+                CategoryList    categoryDelegates;
+                FilterMap       filters;
+                Category        categoryMask {};    // Union of the masks in categoryDelegates
+            #if NOTIFICATIONS_COROUTINES
+                void            Resume(NotificationId id, const any &data);
+
+                // Intrusive lists of suspended Awaiters (written only by its own thread, with the manager locked)
+                std::unordered_map<NotificationId, Awaiter *>   awaiters;
+            #endif
+            };
+
+            using Inbox       = std::array<NotData, kNumPhases>;
+            using Tasks       = std::vector<Task>;
+
+            static constexpr size_t kGroupCapacity = NOTIFICATIONS_GROUP_CAPACITY;
+
+            // Senders push with the manager locked, members pop without locking.
+            // When the queue is full, the notification goes to the inbox of one member (round robin).
+            struct Group {
+                explicit        Group(NotificationId id) : id(id), queue(kGroupCapacity) { }
+
+                bool            IsMember(TID tid) const;
+
+                NotificationId          id;
+                std::vector<TID>        members;
+                BoundedQueue<NotInfo>   queue;
+                size_t                  next {};
+            };
+
+            using GroupPtr    = std::shared_ptr<Group>;
+            using GroupList   = std::vector<GroupPtr>;
+
+            static constexpr size_t kCacheLine = 64;
+
+            // Everything a thread owns, in its own allocation. The owner subscribes and dispatches (the senders
+            // only read 'subscriptions'), while the senders write 'inbox' and 'tasks' (the owner only swaps them).
+            // The padding keeps the senders' fields away from the owner's ones, and from the next allocation.
+            struct ThreadState {
+                Subscriptions   subscriptions;
+                GroupList       groups;
+                char            ownerPadding[kCacheLine];
+                Inbox           inbox;
+                Tasks           tasks;
+                char            senderPadding[kCacheLine];
+            };
+
+        protected:
+            static ThreadState &GetThreadState(TID tid);   // With the manager locked
+            static void         StoreTIDData(NotificationId id, any &&data, bool overwrite, bool includeMe = false, const CancelFlag &cancelled = nullptr, int64_t expiry = kNoExpiry);
+            static void         Flush(Staged &staged);
+            static void         StoreTIDDataUnsafe(NotificationId id, any &&data, bool overwrite, bool includeMe, const CancelFlag &cancelled, int64_t expiry);
+            // Expiry for the TTL of the id (if the send did not set one)
+            static int64_t      GetExpiryUnsafe(NotificationId id, int64_t expiry);
+            // Now + ttl, saturated to kNoExpiry. kNoExpiry if 'ttl' <= 0.
+            static int64_t      GetExpiry(Duration ttl);
+            static Category     GetCategoriesUnsafe(NotificationId id);
+            static const Merge *GetMergeUnsafe(NotificationId id);
+            static Group *      GetGroupUnsafe(NotificationId id);
+            static Phase        GetPhaseUnsafe(NotificationId id);
+            static void         SendStoredNotifications(Phase first, Phase last);
+
+            using StickyValue = std::shared_ptr<const any>;
+
+            // Task executed on 'tid' during its next SendStoredNotificationsForThisThread
+            static void         PostTask(TID tid, Task task);
+
+            static void         UpdateSticky(NotificationId id, const any &data);
+            static StickyValue  GetStickyValue(NotificationId id);
+            static std::mutex & GetStickyMutex()    { return mEnableMT ? mStickyMutex : mFakeMutex; }
+
+            using Transports    = std::vector<Transport *>;
+            using TransportList = std::shared_ptr<const Transports>;
+            using OldTransports = std::vector<std::weak_ptr<const Transports>>;
+
+            // Immutable snapshot, loaded atomically (mTransportMutex only serializes the changes)
+            static TransportList GetTransports();
+            static void         SetTransports(Transports &&transports);
+
+        protected:
+            enum class ThrottleMode { RateLimit, Leading, Trailing, Sampling };
+
+            static constexpr int64_t kNever = std::numeric_limits<int64_t>::min();
+
+            // The configuration is never modified (a new policy replaces the whole Throttle) and the counters
+            // are atomic, so the senders do not lock. Only the pending payload of Trailing needs the throttle mutex.
+            struct Throttle {
+                NotificationId          id;
+                ThrottleMode            mode;
+                int64_t                 interval;       // ns. RateLimit: between two sends at the sustained rate
+                int64_t                 tolerance;      // ns. RateLimit: how much a burst can run ahead of it
+                uint64_t                oneOf;
+                std::atomic<int64_t>    time { kNever };   // RateLimit: theoretical arrival time. Debounce: last send
+                std::atomic<uint64_t>   counter { 0 };
+                any                     pending;
+                CancelFlag              pendingCancelled;
+                int64_t                 pendingExpiry {};
+                int64_t                 deadline {};
+                bool                    pendingOverwrite = false;
+                bool                    hasPending = false;
+            };
+
+            using ThrottlePtr = std::unique_ptr<Throttle>;
+            using Throttles   = std::unordered_map<NotificationId, ThrottlePtr>;
+
+            // Per thread copy of the throttle map, refreshed when the version changes
+            struct ThrottleCache {
+                uint32_t                                        version {};
+                std::unordered_map<NotificationId, Throttle *>  throttles;
+            };
+
+            static void         SendUnthrottled(NotificationId id, any &&data, bool overwrite, const CancelFlag &cancelled, int64_t expiry);
+            static void         SetThrottle(NotificationId id, ThrottlePtr throttle);
+            static Throttle *   FindThrottle(NotificationId id);
+            // Returns true if the notification must not be sent now
+            static bool         IsThrottled(NotificationId id, any &data, bool overwrite, const CancelFlag &cancelled, int64_t expiry);
+            // Sends the Trailing debounces whose interval has elapsed
+            static void         ReleaseDebounced();
+            static int64_t      GetTime();
+            static std::mutex & GetThrottleMutex()  { return mEnableMT ? mThrottleMutex : mFakeMutex; }
+
+        protected:
+
+            // Per thread free list of drained buffers, so the capacity is recycled between drains
+            static NotData      AcquireNotData();
+            static void         ReleaseNotData(NotData &&notData);
+
+            template <typename Data>
+            static void         StoreData(NotData &notData, NotificationId id, Category categories, Data &&data, bool overwrite, const CancelFlag &cancelled, const Merge *merge, int64_t expiry);
 
         private:
                                 NotificationManager()                            = delete;
@@ -93,18 +496,105 @@ namespace MindShake {
             NotificationManager &operator=(NotificationManager &&)               = delete;
 
         protected:
-            using Map      = std::unordered_map<NotificationId, Delegate>;
-            using TIDMap   = std::unordered_map<TID, Map>;
-            using NotData  = std::vector<std::pair<NotificationId, any>>;
-            using TIDData  = std::unordered_map<TID, NotData>;
+            using Threads    = std::unordered_map<TID, std::unique_ptr<ThreadState>>;
+            using Pool       = std::vector<NotData>;
+            using Categories = std::unordered_map<NotificationId, Category>;
+            using Phases     = std::unordered_map<NotificationId, Phase>;
+            using StickyMap  = std::unordered_map<NotificationId, StickyValue>;
+            using Groups     = std::unordered_map<NotificationId, GroupPtr>;
+            using Merges     = std::unordered_map<NotificationId, Merge>;
+            using TTLs       = std::unordered_map<NotificationId, Duration>;
 
         protected:
-            static TIDMap       mTIDNotifications;
-            static TIDData      mTIDData;
+            static Threads      mThreads;
+            static Categories   mCategories;
+            static Phases       mPhases;
+            static Groups       mGroups;
+            static Merges       mMerges;
+            static TTLs         mTTLs;
             static std::mutex   mMutex;
             static fake_mutex   mFakeMutex;
             static bool         mEnableMT;
             static bool         mAutoSend;
+            static bool         mStaging;
+            static size_t       mStagingThreshold;
+
+            static StickyMap            mSticky;
+            static std::mutex           mStickyMutex;
+            static std::atomic<bool>    mHasSticky;
+
+            static TransportList        mTransports;
+            static OldTransports        mOldTransports;     // Snapshots that could still be in use
+            static std::mutex           mTransportMutex;    // Add/RemoveTransport
+            static std::atomic<bool>    mHasTransports;
+
+            static Throttles                mThrottles;
+            static std::vector<ThrottlePtr> mRetiredThrottles;  // Could still be in use by a sender
+            static std::vector<Throttle *>  mDebounced;         // With a pending payload
+            static std::mutex               mThrottleMutex;
+            static std::atomic<bool>        mHasThrottles;
+            static std::atomic<bool>        mHasDebounced;
+            static std::atomic<uint32_t>    mThrottleVersion;
+
+            static thread_local Pool            mNotDataPool;
+            static thread_local Staged          mStaged;
+            static thread_local ThrottleCache   mThrottleCache;
+    };
+
+    //-------------------------------------
+    template <typename T, typename ...Args>
+    inline void
+    NotificationManager::EmplaceNotification(NotificationId id, Args &&...args) {
+    #if defined(NOTIFICATIONS_SMALL_ANY_CAPACITY) || __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+        any data;
+
+        data.emplace<T>(std::forward<Args>(args)...);
+        SendNotification(id, std::move(data));
+    #else
+        SendNotification(id, any(T(std::forward<Args>(args)...)));
+    #endif
+    }
+
+#if NOTIFICATIONS_COROUTINES
+    //-------------------------------------
+    // Buffered stream of notifications for a coroutine on the subscribing thread:
+    //     NotificationStream stream(NotificationId::Log);
+    //     while (true) { any data = co_await stream.Next(); ... }
+    // Notifications received while the coroutine is not waiting are kept in order.
+    // Create and destroy it on the subscribing thread.
+    class NotificationStream {
+        public:
+            class Awaiter {
+                public:
+                    explicit        Awaiter(NotificationStream &stream) : mStream(stream) { }
+
+                    bool            await_ready() const noexcept    { return mStream.mQueue.empty() == false;   }
+                    void            await_suspend(std::coroutine_handle<> handle)   { mStream.mWaiting = handle; }
+                    any             await_resume();
+
+                protected:
+                    NotificationStream  &mStream;
+            };
+
+        public:
+            explicit        NotificationStream(NotificationId id);
+                            NotificationStream(const NotificationStream &) = delete;
+            NotificationStream & operator=(const NotificationStream &) = delete;
+                            ~NotificationStream();
+
+            Awaiter         Next()              { return Awaiter(*this);    }
+            bool            IsEmpty() const     { return mQueue.empty();    }
+            size_t          GetSize() const     { return mQueue.size();     }
+
+        protected:
+            void            Push(const any &data);
+
+        protected:
+            NotificationId          mId;
+            size_t                  mCallableId;
+            std::deque<any>         mQueue;
+            std::coroutine_handle<> mWaiting {};
     };
+#endif
 
 } // end of namespace
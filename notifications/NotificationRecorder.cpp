@@ -0,0 +1,291 @@
+#include "NotificationRecorder.h"
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #define kRecorderMMap   1
+#else
+    #define kRecorderMMap   0
+#endif
+
+using namespace MindShake;
+
+//-------------------------------------
+static constexpr uint32_t kMagic      = 0x4E4D5243;     // 'NMRC'
+static constexpr uint32_t kVersion    = 1;
+static constexpr size_t   kHeaderSize = 2 * sizeof(uint32_t);
+static constexpr size_t   kRecordSize = 2 * sizeof(uint64_t) + sizeof(int32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+static constexpr uint32_t kNoPayload  = uint32_t(-1);
+static constexpr size_t   kMaxPayload = size_t(16) << 20;  // Bigger ones are recorded without payload
+static constexpr size_t   kKeepBuffer = size_t(64) << 10;  // Bigger buffers are released after use
+
+//-------------------------------------
+template <typename T>
+static inline uint8_t *
+Put(uint8_t *buffer, T value) {
+    memcpy(buffer, &value, sizeof(T));
+    return buffer + sizeof(T);
+}
+
+//-------------------------------------
+template <typename T>
+static inline const uint8_t *
+Get(const uint8_t *buffer, T &value) {
+    memcpy(&value, buffer, sizeof(T));
+    return buffer + sizeof(T);
+}
+
+//-------------------------------------
+NotificationRecorder::~NotificationRecorder() {
+    Close();
+}
+
+//-------------------------------------
+bool
+NotificationRecorder::Open(const char *path) {
+    uint8_t header[kHeaderSize];
+
+    Close();
+
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    mFile = fopen(path, "wb");
+    if (mFile == nullptr)
+        return false;
+
+    Put(Put(header, kMagic), kVersion);
+    fwrite(header, 1, sizeof(header), mFile);
+    mStart      = Clock::now();
+    mNumRecords = 0;
+
+    return true;
+}
+
+//-------------------------------------
+void
+NotificationRecorder::Close() {
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mFile != nullptr) {
+        fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+//-------------------------------------
+void
+NotificationRecorder::SetCodec(NotificationId id, PayloadCodec codec) {
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    mCodecs[id] = std::move(codec);
+}
+
+//-------------------------------------
+void
+NotificationRecorder::OnSend(NotificationId id, const any &data, bool overwrite) {
+    uint64_t thread    = uint64_t(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    uint32_t size      = kNoPayload;
+
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mFile == nullptr)
+        return;
+
+    // Open resets mStart under the lock (this also keeps the timestamps in file order)
+    uint64_t timestamp = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mStart).count());
+
+    // Serialize the payload after the record header, growing the buffer if it does not fit
+    const auto &it = mCodecs.find(id);
+    if (it != mCodecs.end()) {
+        if (mBuffer.size() < kRecordSize + 256) {
+            mBuffer.resize(kRecordSize + 256);
+        }
+        size_t written;
+        while ((written = it->second.serialize(data, mBuffer.data() + kRecordSize, mBuffer.size() - kRecordSize)) == PayloadCodec::kNoSpace) {
+            if (mBuffer.size() - kRecordSize >= kMaxPayload)
+                break;
+            mBuffer.resize(std::min(mBuffer.size() * 2, kRecordSize + kMaxPayload));
+        }
+        if (written != PayloadCodec::kError && written != PayloadCodec::kNoSpace) {
+            size = uint32_t(written);
+        }
+    }
+    else if (mBuffer.size() < kRecordSize) {
+        mBuffer.resize(kRecordSize);
+    }
+
+    uint8_t *buffer = mBuffer.data();
+    buffer = Put(buffer, timestamp);
+    buffer = Put(buffer, thread);
+    buffer = Put(buffer, int32_t(id));
+    buffer = Put(buffer, uint8_t(overwrite ? 1 : 0));
+    buffer = Put(buffer, size);
+
+    fwrite(mBuffer.data(), 1, kRecordSize + (size != kNoPayload ? size : 0), mFile);
+    ++mNumRecords;
+
+    if (mBuffer.size() > kKeepBuffer) {
+        std::vector<uint8_t>().swap(mBuffer);
+    }
+}
+
+//-------------------------------------
+NotificationReplayer::~NotificationReplayer() {
+    Close();
+}
+
+//-------------------------------------
+bool
+NotificationReplayer::Open(const char *path) {
+    Close();
+
+#if kRecorderMMap
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat info {};
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void *map = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                mData     = static_cast<const uint8_t *>(map);
+                mSize     = size_t(info.st_size);
+                mIsMapped = true;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    if (mData == nullptr) {
+        FILE *file = fopen(path, "rb");
+        if (file == nullptr)
+            return false;
+
+        uint8_t chunk[4096];
+        size_t  read;
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            mBuffer.insert(mBuffer.end(), chunk, chunk + read);
+        }
+        fclose(file);
+
+        mData = mBuffer.data();
+        mSize = mBuffer.size();
+    }
+
+    if (Parse() == false) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------
+void
+NotificationReplayer::Close() {
+#if kRecorderMMap
+    if (mIsMapped) {
+        munmap(const_cast<uint8_t *>(mData), mSize);
+    }
+#endif
+    mData     = nullptr;
+    mSize     = 0;
+    mIsMapped = false;
+    mBuffer.clear();
+    mRecords.clear();
+}
+
+//-------------------------------------
+bool
+NotificationReplayer::Parse() {
+    const uint8_t   *buffer = mData;
+    const uint8_t   *end    = mData + mSize;
+    uint32_t        magic, version;
+
+    if (mData == nullptr || mSize < kHeaderSize)
+        return false;
+
+    buffer = Get(Get(buffer, magic), version);
+    if (magic != kMagic || version != kVersion)
+        return false;
+
+    // A truncated last record (i.e. the recording process crashed) is ignored
+    while (size_t(end - buffer) >= kRecordSize) {
+        Record  record;
+        int32_t id;
+        uint8_t overwrite;
+
+        buffer = Get(buffer, record.timestamp);
+        buffer = Get(buffer, record.thread);
+        buffer = Get(buffer, id);
+        buffer = Get(buffer, overwrite);
+        buffer = Get(buffer, record.size);
+        record.id        = NotificationId(id);
+        record.overwrite = overwrite != 0;
+        record.payload   = nullptr;
+
+        if (record.size != kNoPayload) {
+            if (size_t(end - buffer) < record.size)
+                break;
+            record.payload = buffer;
+            buffer += record.size;
+        }
+
+        mRecords.emplace_back(record);
+    }
+
+    return true;
+}
+
+//-------------------------------------
+void
+NotificationReplayer::SetCodec(NotificationId id, PayloadCodec codec) {
+    mCodecs[id] = std::move(codec);
+}
+
+//-------------------------------------
+size_t
+NotificationReplayer::Replay(double speed) {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start = Clock::now();
+
+    for (const auto &record : mRecords) {
+        if (speed > 0.0) {
+            auto when = start + std::chrono::nanoseconds(uint64_t(double(record.timestamp) / speed));
+            std::this_thread::sleep_until(when);
+        }
+        Send(record);
+    }
+
+    return mRecords.size();
+}
+
+//-------------------------------------
+void
+NotificationReplayer::Send(const Record &record) {
+    any data = int(0);
+
+    if (record.payload != nullptr) {
+        const auto &it = mCodecs.find(record.id);
+        if (it != mCodecs.end()) {
+            it->second.deserialize(record.payload, record.size, data);
+        }
+    }
+
+    NotificationManager::SendNotification(record.id, std::move(data), record.overwrite);
+}
+
+#undef kRecorderMMap
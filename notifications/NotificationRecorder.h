@@ -0,0 +1,115 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "NotificationManager.h"
+#include "PayloadCodec.h"
+
+//-------------------------------------
+namespace MindShake {
+
+    //-------------------------------------
+    // Append-only binary log of the notifications sent (native endianness):
+    //     Header: magic, version
+    //     Record: timestamp (ns), sender thread (hash), id, overwrite, payload size, payload
+    // Payloads are stored only for ids with a codec, the rest are replayed with the default payload.
+    class NotificationRecorder : public NotificationManager::Transport {
+        public:
+                            NotificationRecorder() = default;
+                            ~NotificationRecorder() override;
+
+                            NotificationRecorder(const NotificationRecorder &)  = delete;
+            NotificationRecorder & operator=(const NotificationRecorder &)   = delete;
+
+            // Add it with NotificationManager::AddTransport to start recording
+            bool            Open(const char *path);
+            void            Close();
+            bool            IsOpen() const      { return mFile != nullptr; }
+
+            template <typename T>
+            void            SetCodec(NotificationId id) { SetCodec(id, PayloadCodec::Trivial<T>()); }
+            void            SetCodec(NotificationId id, PayloadCodec codec);
+
+            uint64_t        GetNumRecords() const   { return mNumRecords; }
+
+        // NotificationManager::Transport
+        public:
+            void            OnSend(NotificationId id, const any &data, bool overwrite) override;
+
+        protected:
+            using Codecs = std::unordered_map<NotificationId, PayloadCodec>;
+            using Clock  = std::chrono::steady_clock;
+
+            FILE                    *mFile {};
+            Clock::time_point       mStart;
+            uint64_t                mNumRecords {};
+            Codecs                  mCodecs;
+            std::vector<uint8_t>    mBuffer;
+            std::mutex              mMutex;
+    };
+
+    //-------------------------------------
+    // Reads a log written by NotificationRecorder (memory mapped when possible) and sends it again.
+    class NotificationReplayer {
+        public:
+            struct Record {
+                uint64_t        timestamp;  // ns since the recording started
+                uint64_t        thread;
+                NotificationId  id;
+                bool            overwrite;
+                const uint8_t   *payload;
+                uint32_t        size;
+            };
+
+            static constexpr double kAsFastAsPossible = 0.0;
+
+        public:
+                            NotificationReplayer() = default;
+                            ~NotificationReplayer();
+
+                            NotificationReplayer(const NotificationReplayer &)  = delete;
+            NotificationReplayer & operator=(const NotificationReplayer &)   = delete;
+
+            bool            Open(const char *path);
+            void            Close();
+            bool            IsOpen() const          { return mData != nullptr; }
+
+            template <typename T>
+            void            SetCodec(NotificationId id) { SetCodec(id, PayloadCodec::Trivial<T>()); }
+            void            SetCodec(NotificationId id, PayloadCodec codec);
+
+            size_t          GetNumRecords() const   { return mRecords.size(); }
+            const Record &  GetRecord(size_t index) const   { return mRecords[index]; }
+
+            // Sends every record from the calling thread with SendNotification.
+            // speed: 1 original timing, 2 twice as fast, ... or kAsFastAsPossible.
+            // Returns the number of notifications sent.
+            size_t          Replay(double speed = 1.0);
+
+        protected:
+            bool            Parse();
+            void            Send(const Record &record);
+
+        protected:
+            using Codecs = std::unordered_map<NotificationId, PayloadCodec>;
+
+            const uint8_t           *mData {};
+            size_t                  mSize {};
+            bool                    mIsMapped = false;
+            std::vector<uint8_t>    mBuffer;    // When it cannot be memory mapped
+            std::vector<Record>     mRecords;
+            Codecs                  mCodecs;
+    };
+
+} // end of namespace
@@ -0,0 +1,287 @@
+#include "NotificationRegistry.h"
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstring>
+#include <algorithm>
+
+using namespace MindShake;
+
+std::vector<std::string>                NotificationRegistry::mNames;
+std::vector<NotificationId>             NotificationRegistry::mIds;
+NotificationRegistry::Names             NotificationRegistry::mIdNames;
+int                                     NotificationRegistry::mNextId = NotificationRegistry::kFirstDynamicId;
+NotificationRegistry::TablePtr          NotificationRegistry::mTable;
+std::mutex                              NotificationRegistry::mMutex;
+std::mutex                              NotificationRegistry::mTableMutex;
+
+//-------------------------------------
+static constexpr size_t   kKeysPerBucket = 4;
+static constexpr uint32_t kMaxSeed       = 1u << 16;
+
+//-------------------------------------
+NotificationId
+NotificationRegistry::Register(const std::string &name) {
+    const std::lock_guard<std::mutex> lock(mMutex);
+    bool                              isNew;
+
+    NotificationId id = RegisterUnsafe(name, isNew);
+    if (isNew) {
+        Rebuild();
+    }
+
+    return id;
+}
+
+//-------------------------------------
+std::vector<NotificationId>
+NotificationRegistry::Register(const std::vector<std::string> &names) {
+    const std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<NotificationId>       ids;
+    bool                              isNew, rebuild = false;
+
+    ids.reserve(names.size());
+    for (const auto &name : names) {
+        ids.emplace_back(RegisterUnsafe(name, isNew));
+        rebuild |= isNew;
+    }
+    if (rebuild) {
+        Rebuild();
+    }
+
+    return ids;
+}
+
+//-------------------------------------
+NotificationId
+NotificationRegistry::RegisterUnsafe(const std::string &name, bool &isNew) {
+    NotificationId  id;
+
+    // The current table is always up to date with the registrations
+    isNew = Find(name, id) == false;
+    if (isNew) {
+        for (size_t i = 0; i < mNames.size(); ++i) {
+            if (mNames[i] == name) {
+                isNew = false;
+                return mIds[i];
+            }
+        }
+
+        id = NotificationId(mNextId++);
+        mNames.emplace_back(name);
+        mIds.emplace_back(id);
+        mIdNames[id] = name;
+    }
+
+    return id;
+}
+
+//-------------------------------------
+bool
+NotificationRegistry::Register(const std::string &name, NotificationId id) {
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    for (size_t i = 0; i < mNames.size(); ++i) {
+        if (mNames[i] == name)
+            return mIds[i] == id;
+    }
+
+    mNames.emplace_back(name);
+    mIds.emplace_back(id);
+    mIdNames[id] = name;
+    Rebuild();
+
+    return true;
+}
+
+//-------------------------------------
+bool
+NotificationRegistry::Find(const char *name, size_t length, NotificationId &id) {
+    TablePtr table = GetTable();
+
+    if (table == nullptr)
+        return false;
+
+    ptrdiff_t index = table->Find(name, length);
+    if (index < 0)
+        return false;
+
+    id = table->ids[index];
+    return true;
+}
+
+//-------------------------------------
+std::string
+NotificationRegistry::GetName(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    const auto &it = mIdNames.find(id);
+    return it != mIdNames.end() ? it->second : std::string();
+}
+
+//-------------------------------------
+size_t
+NotificationRegistry::GetNumIds() {
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    return mNames.size();
+}
+
+//-------------------------------------
+void
+NotificationRegistry::Clear() {
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    mNames.clear();
+    mIds.clear();
+    mIdNames.clear();
+    mNextId = kFirstDynamicId;
+
+    const std::lock_guard<std::mutex> tableLock(mTableMutex);
+    mTable = nullptr;
+}
+
+//-------------------------------------
+// FNV-1a
+uint64_t
+NotificationRegistry::Hash(const char *name, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= uint8_t(name[i]);
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+//-------------------------------------
+// splitmix64 finalizer of the hash displaced by the seed
+uint32_t
+NotificationRegistry::Slot(uint64_t hash, uint32_t seed, size_t numSlots) {
+    hash += uint64_t(seed) * 0x9e3779b97f4a7c15ull;
+    hash  = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash  = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+
+    return uint32_t(hash % numSlots);
+}
+
+//-------------------------------------
+// Called with mMutex locked
+void
+NotificationRegistry::Rebuild() {
+    auto table = std::make_shared<Table>();
+
+    table->names = mNames;
+    table->ids   = mIds;
+    table->hashes.reserve(mNames.size());
+    for (const auto &name : mNames) {
+        table->hashes.emplace_back(Hash(name.data(), name.size()));
+    }
+
+    // ~80% load. If some bucket cannot be placed, try with a bigger table
+    size_t numSlots = mNames.size() + mNames.size() / 4 + 1;
+    while (table->Build(numSlots) == false) {
+        numSlots += numSlots / 4 + 1;
+    }
+
+    const std::lock_guard<std::mutex> lock(mTableMutex);
+    mTable = std::move(table);
+}
+
+//-------------------------------------
+NotificationRegistry::TablePtr
+NotificationRegistry::GetTable() {
+    const std::lock_guard<std::mutex> lock(mTableMutex);
+
+    return mTable;
+}
+
+//-------------------------------------
+// Hash and displace: the keys are grouped in buckets and, from the biggest bucket to the smallest,
+// we look for a seed that sends all the keys of the bucket to free slots.
+bool
+NotificationRegistry::Table::Build(size_t numSlots) {
+    size_t                              numKeys    = names.size();
+    size_t                              numBuckets = numKeys / kKeysPerBucket + 1;
+    std::vector<std::vector<uint32_t>>  buckets(numBuckets);
+    std::vector<uint32_t>               order(numBuckets);
+    std::vector<uint32_t>               candidate;
+
+    seeds.assign(numBuckets, 0);
+    slots.assign(numSlots, -1);
+    collisions.clear();
+
+    // Keys with the same hash go to the same bucket and no seed can separate them,
+    // so only the first one is placed and the others are searched linearly
+    for (uint32_t i = 0; i < numKeys; ++i) {
+        auto &bucket = buckets[hashes[i] % numBuckets];
+        if (std::find_if(bucket.begin(), bucket.end(), [this, i](uint32_t key) { return hashes[key] == hashes[i]; }) != bucket.end())
+            collisions.emplace_back(i);
+        else
+            bucket.emplace_back(i);
+    }
+    for (uint32_t i = 0; i < numBuckets; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    for (uint32_t bucket : order) {
+        const auto &keys = buckets[bucket];
+        if (keys.empty())
+            break;
+
+        uint32_t seed = 0;
+        for (; seed < kMaxSeed; ++seed) {
+            candidate.clear();
+            for (uint32_t key : keys) {
+                uint32_t slot = Slot(hashes[key], seed, numSlots);
+                if (slots[slot] >= 0 || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+                    break;
+                candidate.emplace_back(slot);
+            }
+            if (candidate.size() == keys.size())
+                break;
+        }
+        if (seed == kMaxSeed)
+            return false;
+
+        seeds[bucket] = seed;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            slots[candidate[i]] = int32_t(keys[i]);
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------
+ptrdiff_t
+NotificationRegistry::Table::Find(const char *name, size_t length) const {
+    if (names.empty())
+        return -1;
+
+    uint64_t hash  = Hash(name, length);
+    uint32_t seed  = seeds[hash % seeds.size()];
+    int32_t  index = slots[Slot(hash, seed, slots.size())];
+
+    // A name that was not registered can land in any slot
+    if (index < 0 || hashes[index] != hash)
+        return -1;
+
+    if (names[index].size() == length && memcmp(names[index].data(), name, length) == 0)
+        return index;
+
+    for (uint32_t key : collisions) {
+        if (hashes[key] == hash && names[key].size() == length && memcmp(names[key].data(), name, length) == 0)
+            return key;
+    }
+
+    return -1;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "NotificationManager.h"
+
+// Runtime ids are numbered from here on, so the NotificationId enum must stay below it
+#if !defined(NOTIFICATIONS_FIRST_DYNAMIC_ID)
+    #define NOTIFICATIONS_FIRST_DYNAMIC_ID  0x10000
+#endif
+
+//-------------------------------------
+namespace MindShake {
+
+    //-------------------------------------
+    // Maps names to notification ids, so plugins and scripts can define their own ids at runtime.
+    // Runtime ids are dense integers cast to NotificationId, so they are sent and dispatched
+    // exactly like the compile-time ones. Name lookups use a perfect hash table that is rebuilt
+    // every time the registry changes (lookups are not blocked by the rebuild).
+    class NotificationRegistry {
+        public:
+            static constexpr int kFirstDynamicId = NOTIFICATIONS_FIRST_DYNAMIC_ID;
+
+        public:
+            // Returns the id for 'name', registering a new one if needed
+            static NotificationId   Register(const std::string &name);
+            // Same, but the lookup table is rebuilt only once
+            static std::vector<NotificationId> Register(const std::vector<std::string> &names);
+            // Gives a name to an existing id (i.e. compile-time ones). Fails if the name is already in use.
+            static bool             Register(const std::string &name, NotificationId id);
+
+            static bool             Find(const std::string &name, NotificationId &id)   { return Find(name.data(), name.size(), id); }
+            static bool             Find(const char *name, size_t length, NotificationId &id);
+            static std::string      GetName(NotificationId id);
+            static size_t           GetNumIds();
+
+            static void             Clear();
+
+        protected:
+            struct Table {
+                bool                        Build(size_t numSlots);
+                ptrdiff_t                   Find(const char *name, size_t length) const;
+
+                std::vector<std::string>    names;
+                std::vector<NotificationId> ids;
+                std::vector<uint64_t>       hashes;
+                std::vector<uint32_t>       seeds;      // Per bucket
+                std::vector<int32_t>        slots;      // Index in names/ids or -1
+                std::vector<uint32_t>       collisions; // Keys with the same hash as a placed one
+            };
+
+            using TablePtr = std::shared_ptr<const Table>;
+
+            static uint64_t         Hash(const char *name, size_t length);
+            static uint32_t         Slot(uint64_t hash, uint32_t seed, size_t numSlots);
+            static NotificationId   RegisterUnsafe(const std::string &name, bool &isNew);
+            static void             Rebuild();
+            static TablePtr         GetTable();
+
+        private:
+                                    NotificationRegistry()                              = delete;
+                                    ~NotificationRegistry()                             = delete;
+                                    NotificationRegistry(const NotificationRegistry &)  = delete;
+            NotificationRegistry &  operator=(const NotificationRegistry &)             = delete;
+
+        protected:
+            using Names = std::unordered_map<NotificationId, std::string>;
+
+            static std::vector<std::string>     mNames;     // Registration order
+            static std::vector<NotificationId>  mIds;
+            static Names                        mIdNames;
+            static int                          mNextId;
+            static TablePtr                     mTable;
+            static std::mutex                   mMutex;         // Registrations
+            static std::mutex                   mTableMutex;    // Only to copy mTable
+    };
+
+} // end of namespace
@@ -0,0 +1,74 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include "NotificationManager.h"
+
+//-------------------------------------
+namespace MindShake {
+
+    //-------------------------------------
+    // Converts payloads to bytes and back, to send them outside the process.
+    struct PayloadCodec {
+        // Returns the number of bytes written into 'buffer', kNoSpace if the payload does not fit
+        // (it can be retried with a bigger buffer) or kError if it cannot be serialized (i.e. unexpected type)
+        using Serializer   = std::function<size_t(const any &data, uint8_t *buffer, size_t capacity)>;
+        // Returns false if the bytes cannot be converted
+        using Deserializer = std::function<bool(const uint8_t *buffer, size_t size, any &data)>;
+
+        static constexpr size_t kError   = size_t(-1);
+        static constexpr size_t kNoSpace = size_t(-2);
+
+        // memcpy based codec for trivially copyable payloads
+        template <typename T>
+        static PayloadCodec Trivial();
+
+        bool IsValid() const    { return serialize != nullptr && deserialize != nullptr; }
+
+        Serializer      serialize;
+        Deserializer    deserialize;
+    };
+
+    //-------------------------------------
+    template <typename T>
+    inline PayloadCodec
+    PayloadCodec::Trivial() {
+        static_assert(std::is_trivially_copyable<T>::value, "Use a custom PayloadCodec for non trivially copyable payloads");
+
+        PayloadCodec codec;
+
+        codec.serialize = [](const any &data, uint8_t *buffer, size_t capacity) -> size_t {
+            const T *value = any_cast<T>(&data);
+            if (value == nullptr)
+                return kError;
+            if (capacity < sizeof(T))
+                return kNoSpace;
+
+            memcpy(buffer, value, sizeof(T));
+            return sizeof(T);
+        };
+
+        codec.deserialize = [](const uint8_t *buffer, size_t size, any &data) -> bool {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
+
+            if (size != sizeof(T))
+                return false;
+
+            memcpy(&value, buffer, sizeof(T));
+            data = *reinterpret_cast<const T *>(&value);
+            return true;
+        };
+
+        return codec;
+    }
+
+} // end of namespace
@@ -0,0 +1,346 @@
+#include "SharedMemoryTransport.h"
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace MindShake;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory needs lock-free 64 bits atomics");
+
+//-------------------------------------
+static constexpr uint32_t kMagic        = 0x4E4D5348;   // 'NMSH'
+static constexpr uint32_t kVersion      = 1;
+static constexpr uint64_t kSlotBusy     = uint64_t(-1);
+static constexpr size_t   kCacheLine    = 64;
+// A slot busy for longer belongs to a writer that is too slow (or died while writing it)
+static constexpr std::chrono::milliseconds kBusyTimeout(100);
+
+//-------------------------------------
+struct SharedMemoryTransport::Header {
+    std::atomic<uint32_t>   magic;
+    uint32_t                version;
+    uint32_t                numSlots;
+    uint32_t                slotSize;
+    uint32_t                slotStride;
+    alignas(kCacheLine)
+    std::atomic<uint64_t>   head;       // Next sequence to write
+};
+
+//-------------------------------------
+// 'sequence' is the sequence number + 1 of the message stored (0 if none), or kSlotBusy while writing
+struct SharedMemoryTransport::Slot {
+    std::atomic<uint64_t>   sequence;
+    uint32_t                processId;
+    int32_t                 id;
+    uint32_t                size;
+    uint32_t                overwrite;
+
+    uint8_t *               GetData()   { return reinterpret_cast<uint8_t *>(this + 1); }
+};
+
+//-------------------------------------
+size_t
+SharedMemoryTransport::GetHeaderSize() {
+    return (sizeof(Header) + kCacheLine - 1) & ~(kCacheLine - 1);
+}
+
+//-------------------------------------
+SharedMemoryTransport::~SharedMemoryTransport() {
+    Close();
+}
+
+//-------------------------------------
+bool
+SharedMemoryTransport::Open(const char *name, uint32_t numSlots, uint32_t slotSize) {
+    struct stat info {};
+    uint32_t    slots      = 1;
+    uint32_t    slotStride;
+    size_t      headerSize = GetHeaderSize();
+    bool        created    = true;
+    int         fd;
+
+    Close();
+
+    while (slots < numSlots) {
+        slots <<= 1;
+    }
+    slotStride = uint32_t((sizeof(Slot) + slotSize + kCacheLine - 1) & ~(kCacheLine - 1));
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        created = false;
+        fd = shm_open(name, O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+    }
+
+    if (created) {
+        mMapSize = headerSize + size_t(slots) * slotStride;
+        if (ftruncate(fd, off_t(mMapSize)) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return false;
+        }
+    }
+    else {
+        // Wait until the creator has set its size
+        for (int i = 0; i < 1000; ++i) {
+            if (fstat(fd, &info) == 0 && size_t(info.st_size) >= headerSize)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        mMapSize = size_t(info.st_size);
+        if (mMapSize < headerSize) {
+            close(fd);
+            return false;
+        }
+    }
+
+    void *map = mmap(nullptr, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    mHeader = static_cast<Header *>(map);
+    if (created) {
+        // ftruncate fills it with zeros, so all the slots are empty
+        mHeader->version    = kVersion;
+        mHeader->numSlots   = slots;
+        mHeader->slotSize   = slotSize;
+        mHeader->slotStride = slotStride;
+        mHeader->head.store(0, std::memory_order_relaxed);
+        mHeader->magic.store(kMagic, std::memory_order_release);
+    }
+    else {
+        for (int i = 0; i < 1000 && mHeader->magic.load(std::memory_order_acquire) != kMagic; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (mHeader->magic.load(std::memory_order_acquire) != kMagic || mHeader->version != kVersion ||
+            headerSize + size_t(mHeader->numSlots) * mHeader->slotStride > mMapSize) {
+            Close();
+            return false;
+        }
+    }
+
+    mProcessId = uint32_t(getpid());
+    mCursor    = mHeader->head.load(std::memory_order_acquire);    // Only new messages
+    mDropped   = 0;
+    mNotSent   = 0;
+    mBusySince = {};
+    mReadBuffer.resize(mHeader->slotSize);
+
+    return true;
+}
+
+//-------------------------------------
+void
+SharedMemoryTransport::Close() {
+    const std::lock_guard<std::mutex> lock(mReadMutex);
+
+    if (mHeader != nullptr) {
+        munmap(mHeader, mMapSize);
+        mHeader  = nullptr;
+        mMapSize = 0;
+    }
+}
+
+//-------------------------------------
+void
+SharedMemoryTransport::Unlink(const char *name) {
+    shm_unlink(name);
+}
+
+//-------------------------------------
+void
+SharedMemoryTransport::Share(NotificationId id, PayloadCodec codec) {
+    const std::lock_guard<std::mutex> lock(mCodecsMutex);
+
+    mCodecs[id] = std::move(codec);
+}
+
+//-------------------------------------
+void
+SharedMemoryTransport::Unshare(NotificationId id) {
+    const std::lock_guard<std::mutex> lock(mCodecsMutex);
+
+    mCodecs.erase(id);
+}
+
+//-------------------------------------
+SharedMemoryTransport::Slot *
+SharedMemoryTransport::GetSlot(uint64_t sequence) const {
+    size_t index = size_t(sequence & (mHeader->numSlots - 1));
+
+    return reinterpret_cast<Slot *>(reinterpret_cast<uint8_t *>(mHeader) + GetHeaderSize() + index * mHeader->slotStride);
+}
+
+//-------------------------------------
+void
+SharedMemoryTransport::OnSend(NotificationId id, const any &data, bool overwrite) {
+    static thread_local std::vector<uint8_t>    buffer;
+    PayloadCodec::Serializer                    serialize;
+    size_t                                      size;
+
+    if (mHeader == nullptr)
+        return;
+
+    {
+        const std::lock_guard<std::mutex> lock(mCodecsMutex);
+        const auto &it = mCodecs.find(id);
+        if (it == mCodecs.end())
+            return;
+        serialize = it->second.serialize;
+    }
+
+    // Serialize outside the ring, so a slow serializer never keeps a slot busy
+    buffer.resize(mHeader->slotSize);
+    size = serialize(data, buffer.data(), buffer.size());
+    if (size == PayloadCodec::kError || size == PayloadCodec::kNoSpace || size > mHeader->slotSize)
+        return;
+
+    Write(id, overwrite, buffer.data(), size);
+}
+
+//-------------------------------------
+bool
+SharedMemoryTransport::Write(NotificationId id, bool overwrite, const uint8_t *data, size_t size) {
+    uint64_t    sequence = mHeader->head.fetch_add(1, std::memory_order_acq_rel);
+    Slot        *slot    = GetSlot(sequence);
+    uint64_t    expected = slot->sequence.load(std::memory_order_relaxed);
+
+    // Only another writer, a whole lap behind, could be using this slot or have published a newer message in it.
+    // We never write over another writer nor replace a newer message: our message is dropped instead.
+    std::chrono::steady_clock::time_point deadline {};
+    while (true) {
+        if (expected != kSlotBusy) {
+            if (expected >= sequence + 1) {
+                ++mNotSent;
+                return false;
+            }
+            if (slot->sequence.compare_exchange_weak(expected, kSlotBusy, std::memory_order_acquire, std::memory_order_relaxed))
+                break;
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (deadline == std::chrono::steady_clock::time_point()) {
+            deadline = now + kBusyTimeout;
+        }
+        else if (now >= deadline) {
+            ++mNotSent;
+            return false;
+        }
+        std::this_thread::yield();
+        expected = slot->sequence.load(std::memory_order_relaxed);
+    }
+
+    slot->processId = mProcessId;
+    slot->id        = int32_t(id);
+    slot->size      = uint32_t(size);
+    slot->overwrite = overwrite ? 1 : 0;
+    memcpy(slot->GetData(), data, size);
+
+    slot->sequence.store(sequence + 1, std::memory_order_release);
+
+    return true;
+}
+
+//-------------------------------------
+void
+SharedMemoryTransport::Poll() {
+    // Only one thread reads at a time, the others will get them on their drain
+    std::unique_lock<std::mutex> lock(mReadMutex, std::try_to_lock);
+    if (lock.owns_lock() == false || mHeader == nullptr)
+        return;
+
+    const uint64_t numSlots = mHeader->numSlots;
+    uint64_t       head     = mHeader->head.load(std::memory_order_acquire);
+
+    // Too far behind: skip what has already been overwritten
+    if (head - mCursor > numSlots) {
+        mDropped += head - numSlots - mCursor;
+        mCursor   = head - numSlots;
+    }
+
+    while (mCursor < head) {
+        Slot     *slot     = GetSlot(mCursor);
+        uint64_t sequence  = slot->sequence.load(std::memory_order_acquire);
+
+        if (sequence == kSlotBusy && mCursor + 1 < head) {
+            // Do not wait forever for a writer that died while writing it
+            auto now = std::chrono::steady_clock::now();
+            if (mBusySince == TimePoint()) {
+                mBusySince = now;
+            }
+            else if (now - mBusySince >= kBusyTimeout) {
+                mBusySince = {};
+                ++mDropped;
+                ++mCursor;
+                continue;
+            }
+            break;
+        }
+        mBusySince = {};
+
+        if (sequence == kSlotBusy || sequence < mCursor + 1)
+            break;  // Not published yet
+
+        if (sequence > mCursor + 1) {
+            // Lapped by the writers
+            ++mDropped;
+            ++mCursor;
+            continue;
+        }
+
+        uint32_t processId = slot->processId;
+        int32_t  id        = slot->id;
+        uint32_t size      = slot->size;
+        bool     overwrite = slot->overwrite != 0;
+        if (size <= mReadBuffer.size()) {
+            memcpy(mReadBuffer.data(), slot->GetData(), size);
+        }
+
+        // Check that no writer reused the slot while we were reading it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != mCursor + 1 || size > mReadBuffer.size()) {
+            ++mDropped;
+            ++mCursor;
+            continue;
+        }
+        ++mCursor;
+
+        // Our own messages were already delivered by SendNotification
+        if (processId == mProcessId)
+            continue;
+
+        PayloadCodec::Deserializer deserialize;
+        {
+            const std::lock_guard<std::mutex> codecsLock(mCodecsMutex);
+            const auto &it = mCodecs.find(NotificationId(id));
+            if (it == mCodecs.end())
+                continue;
+            deserialize = it->second.deserialize;
+        }
+
+        any data;
+        if (deserialize(mReadBuffer.data(), size, data)) {
+            NotificationManager::Deliver(NotificationId(id), std::move(data), overwrite);
+        }
+    }
+}
+
+#endif
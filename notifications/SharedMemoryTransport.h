@@ -0,0 +1,86 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "NotificationManager.h"
+#include "PayloadCodec.h"
+
+//-------------------------------------
+namespace MindShake {
+
+    //-------------------------------------
+    // Exchanges the shared ids with other processes on the same host through a lock-free
+    // ring buffer in POSIX shared memory. Every process attached to the same name receives
+    // the notifications sent by the others during SendStoredNotificationsForThisThread.
+    // Writers never wait for readers: a reader that falls more than 'numSlots' behind loses
+    // the oldest messages (see GetDropped).
+    class SharedMemoryTransport : public NotificationManager::Transport {
+        public:
+                            SharedMemoryTransport() = default;
+                            ~SharedMemoryTransport() override;
+
+                            SharedMemoryTransport(const SharedMemoryTransport &)    = delete;
+            SharedMemoryTransport & operator=(const SharedMemoryTransport &)     = delete;
+
+            // Creates the ring buffer or attaches to an existing one (then its geometry is used).
+            // 'numSlots' is rounded up to a power of two, 'slotSize' is the maximum serialized payload size.
+            bool            Open(const char *name, uint32_t numSlots = 1024, uint32_t slotSize = 256);
+            void            Close();
+            bool            IsOpen() const      { return mHeader != nullptr; }
+            // Removes the shared memory object (processes already attached keep their mapping)
+            static void     Unlink(const char *name);
+
+            // Ids exchanged with other processes. Every process must share them with the same codec.
+            template <typename T>
+            void            Share(NotificationId id)    { Share(id, PayloadCodec::Trivial<T>()); }
+            void            Share(NotificationId id, PayloadCodec codec);
+            void            Unshare(NotificationId id);
+
+            // Messages lost because this process read them too late (or their writer never finished them)
+            uint64_t        GetDropped() const  { return mDropped; }
+            // Messages of this process that were not written because their slot was still being written
+            // by a slower writer (or already held a newer message)
+            uint64_t        GetNotSent() const  { return mNotSent; }
+
+        // NotificationManager::Transport
+        public:
+            void            OnSend(NotificationId id, const any &data, bool overwrite) override;
+            void            Poll() override;
+
+        protected:
+            struct Header;
+            struct Slot;
+
+            static size_t   GetHeaderSize();
+            Slot *          GetSlot(uint64_t sequence) const;
+            bool            Write(NotificationId id, bool overwrite, const uint8_t *data, size_t size);
+
+        protected:
+            using Codecs    = std::unordered_map<NotificationId, PayloadCodec>;
+            using TimePoint = std::chrono::steady_clock::time_point;
+
+            Header                  *mHeader    {};
+            size_t                  mMapSize    {};
+            uint64_t                mCursor     {};
+            std::atomic<uint64_t>   mDropped    { 0 };
+            std::atomic<uint64_t>   mNotSent    { 0 };
+            TimePoint               mBusySince  {};     // Since when the slot at mCursor is busy
+            uint32_t                mProcessId  {};
+            Codecs                  mCodecs;
+            std::mutex              mCodecsMutex;
+            std::mutex              mReadMutex;
+            std::vector<uint8_t>    mReadBuffer;
+    };
+
+} // end of namespace
@@ -0,0 +1,264 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <typeinfo>
+#include <type_traits>
+
+// Type checks do not rely on RTTI, so SmallAny can be used with -fno-rtti (type() is not available then)
+#if defined(__GXX_RTTI) || defined(_CPPRTTI)
+    #define kSmallAnyRTTI   1
+#else
+    #define kSmallAnyRTTI   0
+#endif
+
+//-------------------------------------
+namespace MindShake {
+
+    //-------------------------------------
+    class bad_any_cast : public std::bad_cast {
+        public:
+            const char *    what() const noexcept override { return "bad any cast"; }
+    };
+
+    //-------------------------------------
+    // Drop-in replacement for any with an inline buffer of 'Capacity' bytes.
+    // Types that fit in the buffer (size, alignment and a noexcept move constructor) never allocate,
+    // bigger ones fall back to the heap. Use IsInline<T>() to check it at compile time.
+    // Every stored type has its own static tag, so its address identifies the type and any_cast
+    // is a single pointer compare. The tag is writable: identical const VTables of different types
+    // could be folded into one by the linker (i.e. MSVC /OPT:ICF), but different variables cannot.
+    template <size_t Capacity = 64>
+    class SmallAny {
+        protected:
+            static constexpr size_t kSize  = Capacity < sizeof(void *) ? sizeof(void *) : Capacity;
+            static constexpr size_t kAlign = alignof(std::max_align_t);
+
+            union Storage {
+                alignas(kAlign) unsigned char   buffer[kSize];
+                void                            *heap;
+            };
+
+            struct VTable {
+                const void              *tag;
+            #if kSmallAnyRTTI
+                const std::type_info &  (*type)();
+            #endif
+                void                    (*destroy)(Storage &storage);
+                void                    (*copy)(const Storage &src, Storage &dst);
+                void                    (*move)(Storage &src, Storage &dst);
+                void *                  (*get)(Storage &storage);
+            };
+
+            template <typename T>
+            struct Inline {
+            #if kSmallAnyRTTI
+                static const std::type_info &   type()                                  { return typeid(T);                                                     }
+            #endif
+                static void                     destroy(Storage &storage)               { reinterpret_cast<T *>(storage.buffer)->~T();                          }
+                static void                     copy(const Storage &src, Storage &dst)  { new (dst.buffer) T(*reinterpret_cast<const T *>(src.buffer));         }
+                static void                     move(Storage &src, Storage &dst)        { new (dst.buffer) T(std::move(*reinterpret_cast<T *>(src.buffer)));    destroy(src); }
+                static void *                   get(Storage &storage)                   { return storage.buffer;                                                }
+
+                template <typename ...Args>
+                static void                     create(Storage &storage, Args &&...args) { new (storage.buffer) T(std::forward<Args>(args)...);                 }
+
+                static const VTable             vtable;
+                static char                     tag;
+            };
+
+            template <typename T>
+            struct Heap {
+            #if kSmallAnyRTTI
+                static const std::type_info &   type()                                  { return typeid(T);                                                     }
+            #endif
+                static void                     destroy(Storage &storage)               { delete static_cast<T *>(storage.heap);                                }
+                static void                     copy(const Storage &src, Storage &dst)  { dst.heap = new T(*static_cast<const T *>(src.heap));                  }
+                static void                     move(Storage &src, Storage &dst)        { dst.heap = src.heap; src.heap = nullptr;                              }
+                static void *                   get(Storage &storage)                   { return storage.heap;                                                  }
+
+                template <typename ...Args>
+                static void                     create(Storage &storage, Args &&...args) { storage.heap = new T(std::forward<Args>(args)...);                   }
+
+                static const VTable             vtable;
+                static char                     tag;
+            };
+
+            template <typename T>
+            using Handler = typename std::conditional<sizeof(T) <= kSize && alignof(T) <= kAlign && std::is_nothrow_move_constructible<T>::value, Inline<T>, Heap<T>>::type;
+
+            template <typename T>
+            using Decay = typename std::decay<T>::type;
+
+            template <typename T>
+            using NotSelf = typename std::enable_if<!std::is_same<Decay<T>, SmallAny>::value, bool>::type;
+
+        public:
+                            SmallAny() = default;
+                            SmallAny(const SmallAny &other)                                     { if (other.mVTable != nullptr) { other.mVTable->copy(other.mStorage, mStorage); mVTable = other.mVTable; } }
+                            SmallAny(SmallAny &&other) noexcept                                 { if (other.mVTable != nullptr) { other.mVTable->move(other.mStorage, mStorage); mVTable = other.mVTable; other.mVTable = nullptr; } }
+            template <typename T, NotSelf<T> = true>
+                            SmallAny(T &&value)                                                 { emplace<Decay<T>>(std::forward<T>(value));                    }
+                            ~SmallAny()                                                         { reset();                                                      }
+
+            SmallAny &      operator=(const SmallAny &other)                                    { SmallAny(other).swap(*this);              return *this;       }
+            SmallAny &      operator=(SmallAny &&other) noexcept                                { SmallAny(std::move(other)).swap(*this);   return *this;       }
+            template <typename T, NotSelf<T> = true>
+            SmallAny &      operator=(T &&value)                                                { SmallAny(std::forward<T>(value)).swap(*this); return *this;   }
+
+            template <typename T, typename ...Args>
+            Decay<T> &      emplace(Args &&...args);
+
+            void            reset() noexcept                                                    { if (mVTable != nullptr) { mVTable->destroy(mStorage); mVTable = nullptr; } }
+            void            swap(SmallAny &other) noexcept;
+
+            bool            has_value() const noexcept                                          { return mVTable != nullptr;                                    }
+        #if kSmallAnyRTTI
+            const std::type_info &  type() const noexcept                                       { return mVTable != nullptr ? mVTable->type() : typeid(void);   }
+        #endif
+
+            // Unique per stored type (nullptr when empty)
+            const void *    type_id() const noexcept                                            { return mVTable != nullptr ? mVTable->tag : nullptr;           }
+            template <typename T>
+            static const void * TypeId() noexcept                                               { return &Handler<Decay<T>>::tag;                               }
+
+            template <typename T>
+            static constexpr bool IsInline()                                                    { return std::is_same<Handler<Decay<T>>, Inline<Decay<T>>>::value; }
+
+            // Used by any_cast
+            template <typename T>
+            T *             Get() noexcept                                                      { return mVTable != nullptr && mVTable->tag == &Handler<Decay<T>>::tag ? static_cast<T *>(mVTable->get(mStorage)) : nullptr; }
+
+        protected:
+            Storage         mStorage;
+            const VTable    *mVTable {};
+    };
+
+    //-------------------------------------
+    template <size_t Capacity>
+    template <typename T>
+    const typename SmallAny<Capacity>::VTable SmallAny<Capacity>::Inline<T>::vtable = {
+        &tag,
+    #if kSmallAnyRTTI
+        &type,
+    #endif
+        &destroy, &copy, &move, &get
+    };
+
+    template <size_t Capacity>
+    template <typename T>
+    const typename SmallAny<Capacity>::VTable SmallAny<Capacity>::Heap<T>::vtable = {
+        &tag,
+    #if kSmallAnyRTTI
+        &type,
+    #endif
+        &destroy, &copy, &move, &get
+    };
+
+    template <size_t Capacity>
+    template <typename T>
+    char SmallAny<Capacity>::Inline<T>::tag;
+
+    template <size_t Capacity>
+    template <typename T>
+    char SmallAny<Capacity>::Heap<T>::tag;
+
+    //-------------------------------------
+    template <size_t Capacity>
+    template <typename T, typename ...Args>
+    inline typename std::decay<T>::type &
+    SmallAny<Capacity>::emplace(Args &&...args) {
+        using Type = Handler<Decay<T>>;
+
+        reset();
+        Type::create(mStorage, std::forward<Args>(args)...);
+        mVTable = &Type::vtable;
+
+        return *static_cast<Decay<T> *>(mVTable->get(mStorage));
+    }
+
+    //-------------------------------------
+    template <size_t Capacity>
+    inline void
+    SmallAny<Capacity>::swap(SmallAny &other) noexcept {
+        if (this == &other)
+            return;
+
+        SmallAny tmp(std::move(other));
+        if (mVTable != nullptr) {
+            mVTable->move(mStorage, other.mStorage);
+            other.mVTable = mVTable;
+            mVTable = nullptr;
+        }
+        if (tmp.mVTable != nullptr) {
+            tmp.mVTable->move(tmp.mStorage, mStorage);
+            mVTable = tmp.mVTable;
+            tmp.mVTable = nullptr;
+        }
+    }
+
+    // any_cast
+    //-------------------------------------
+    template <typename T, size_t Capacity>
+    inline const T *
+    any_cast(const SmallAny<Capacity> *operand) noexcept {
+        return operand != nullptr ? const_cast<SmallAny<Capacity> *>(operand)->template Get<T>() : nullptr;
+    }
+
+    //-------------------------------------
+    template <typename T, size_t Capacity>
+    inline T *
+    any_cast(SmallAny<Capacity> *operand) noexcept {
+        return operand != nullptr ? operand->template Get<T>() : nullptr;
+    }
+
+    //-------------------------------------
+    template <typename T, size_t Capacity>
+    inline T
+    any_cast(const SmallAny<Capacity> &operand) {
+        using Type = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+        const Type *value = any_cast<Type>(&operand);
+        if (value == nullptr)
+            throw bad_any_cast();
+
+        return static_cast<T>(*value);
+    }
+
+    //-------------------------------------
+    template <typename T, size_t Capacity>
+    inline T
+    any_cast(SmallAny<Capacity> &operand) {
+        using Type = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+        Type *value = any_cast<Type>(&operand);
+        if (value == nullptr)
+            throw bad_any_cast();
+
+        return static_cast<T>(*value);
+    }
+
+    //-------------------------------------
+    template <typename T, size_t Capacity>
+    inline T
+    any_cast(SmallAny<Capacity> &&operand) {
+        using Type = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+        Type *value = any_cast<Type>(&operand);
+        if (value == nullptr)
+            throw bad_any_cast();
+
+        return static_cast<T>(std::move(*value));
+    }
+
+    #undef kSmallAnyRTTI
+
+} // end of namespace
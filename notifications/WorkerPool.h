@@ -0,0 +1,213 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (C) 2021 Carlos Aragonés
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+//-----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+//-------------------------------------
+namespace MindShake {
+
+    //-------------------------------------
+    // Fixed set of threads to split a job in parts. The calling thread works too, and Run returns
+    // when all the parts are finished. Only one Run uses the workers at a time: concurrent (or nested)
+    // calls do all their parts on the calling thread instead of waiting.
+    class WorkerPool {
+        public:
+            using Job = std::function<void(size_t part)>;
+
+        public:
+            explicit        WorkerPool(size_t numWorkers);
+                            ~WorkerPool();
+
+                            WorkerPool(const WorkerPool &)  = delete;
+            WorkerPool &    operator=(const WorkerPool &)   = delete;
+
+            // Shared pool with a worker per core (but the calling one), created on first use
+            static WorkerPool & GetDefault();
+
+            // Calls job(0) ... job(numParts - 1). The first exception thrown by a part is rethrown here.
+            void            Run(size_t numParts, const Job &job);
+
+            size_t          GetNumWorkers() const   { return mWorkers.size(); }
+
+        protected:
+            // Pools whose Run is in progress on this thread (a list on the stack of the callers)
+            struct Running {
+                explicit            Running(const WorkerPool *p) : pool(p), prev(GetRunning())  { GetRunning() = this;    }
+                                    ~Running()                                                  { GetRunning() = prev;    }
+
+                const WorkerPool    *pool;
+                Running             *prev;
+            };
+
+            static Running *&   GetRunning();
+            bool                IsRunningHere() const;
+
+            void            Work();
+            void            Execute();
+
+        protected:
+            std::vector<std::thread>    mWorkers;
+            std::mutex                  mRunMutex;
+            std::mutex                  mMutex;
+            std::condition_variable     mWake;
+            std::condition_variable     mDone;
+            const Job                   *mJob {};
+            size_t                      mNumParts {};
+            std::atomic<size_t>         mNextPart { 0 };
+            size_t                      mNumBusy {};
+            uint64_t                    mGeneration {};
+            std::exception_ptr          mException;
+            bool                        mQuit = false;
+    };
+
+    //-------------------------------------
+    inline
+    WorkerPool::WorkerPool(size_t numWorkers) {
+        mWorkers.reserve(numWorkers);
+        for (size_t i = 0; i < numWorkers; ++i) {
+            mWorkers.emplace_back(&WorkerPool::Work, this);
+        }
+    }
+
+    //-------------------------------------
+    inline
+    WorkerPool::~WorkerPool() {
+        {
+            const std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mWake.notify_all();
+
+        for (auto &worker : mWorkers) {
+            worker.join();
+        }
+    }
+
+    //-------------------------------------
+    inline WorkerPool &
+    WorkerPool::GetDefault() {
+        static WorkerPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+
+        return pool;
+    }
+
+    //-------------------------------------
+    inline WorkerPool::Running *&
+    WorkerPool::GetRunning() {
+        static thread_local Running *running = nullptr;
+
+        return running;
+    }
+
+    //-------------------------------------
+    inline bool
+    WorkerPool::IsRunningHere() const {
+        for (Running *running = GetRunning(); running != nullptr; running = running->prev) {
+            if (running->pool == this)
+                return true;
+        }
+
+        return false;
+    }
+
+    //-------------------------------------
+    inline void
+    WorkerPool::Run(size_t numParts, const Job &job) {
+        std::unique_lock<std::mutex> run(mRunMutex, std::defer_lock);
+
+        // A nested call from the thread that owns mRunMutex must not try to lock it again
+        if (numParts > 1 && mWorkers.empty() == false && IsRunningHere() == false) {
+            run.try_lock();
+        }
+
+        if (run.owns_lock() == false) {
+            for (size_t i = 0; i < numParts; ++i) {
+                job(i);
+            }
+            return;
+        }
+
+        const Running running(this);
+
+        {
+            const std::lock_guard<std::mutex> lock(mMutex);
+            mJob       = &job;
+            mNumParts  = numParts;
+            mNextPart  = 0;
+            mNumBusy   = mWorkers.size();
+            mException = nullptr;
+            ++mGeneration;
+        }
+        mWake.notify_all();
+
+        Execute();
+
+        std::exception_ptr exception;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDone.wait(lock, [this]() { return mNumBusy == 0; });
+            mJob = nullptr;
+            std::swap(exception, mException);
+        }
+
+        if (exception != nullptr) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    //-------------------------------------
+    inline void
+    WorkerPool::Work() {
+        uint64_t generation = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWake.wait(lock, [this, &generation]() { return mQuit || mGeneration != generation; });
+                if (mQuit)
+                    return;
+                generation = mGeneration;
+            }
+
+            Execute();
+
+            const std::lock_guard<std::mutex> lock(mMutex);
+            if (--mNumBusy == 0) {
+                mDone.notify_one();
+            }
+        }
+    }
+
+    //-------------------------------------
+    // The parts are taken one by one, so the threads that finish early help with the rest
+    inline void
+    WorkerPool::Execute() {
+        size_t part;
+
+        while ((part = mNextPart.fetch_add(1, std::memory_order_relaxed)) < mNumParts) {
+            try {
+                (*mJob)(part);
+            }
+            catch (...) {
+                const std::lock_guard<std::mutex> lock(mMutex);
+                if (mException == nullptr) {
+                    mException = std::current_exception();
+                }
+            }
+        }
+    }
+
+} // end of namespace